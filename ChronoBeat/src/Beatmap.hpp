@@ -1,44 +1,150 @@
 ﻿#pragma once
 #include "Note.hpp"
+#include "BeatmapBinary.hpp"
+#include "BeatmapMapping.hpp"
+#include "BeatmapCache.hpp"
 
 struct Beatmap {
-	JSON json = nullptr;
-
 	double bpm = 0.0;
-	double offset = 0.0;
+
+	/// @brief 譜面の先頭の時間(マイクロ秒)
+	int64 offset = 0;
+
+	/// @brief 曲の長さ(秒)
 	double length = 0.0;
 
-	Array<std::shared_ptr<Note>> notes;
+	/// @brief 読み込んだ譜面のノーツ(時間順, メモリマップした場合は空)
+	Array<BeatmapBinary::NoteRecord> chartRecords;
+
+	/// @brief メモリマップで読み込んだ場合のマッピング
+	std::shared_ptr<const BeatmapMapping> mapping;
 
 	size_t maxCombo = 0;
 
+	/// @brief 譜面のレーン数
+	int32 laneCount = Globals::defaultLaneNum;
+
 	Beatmap() = default;
 
-	Beatmap(const FilePath& path, double _length, bool timingOffset = true) : json{ JSON::Load(Resource(path)) }, length{ _length } {
-		bpm = json[U"BPM"].get<double>();
+	/// @brief 譜面の読み込み
+	/// @param path 譜面のパス(.json or .cbm)
+	/// @param _length 曲の長さ
+	/// @param timingOffset 先頭に4拍分の猶予を入れるか
+	Beatmap(const FilePath& path, double _length, bool timingOffset = true) : length{ _length } {
+		if (FileSystem::Extension(path) == BeatmapBinary::Extension) {
+			const Optional<BeatmapBinary::Chart> chart = BeatmapBinary::Load(Resource(path));
 
-		offset = (json[U"offset"].get<double>() / 1000) +
-			timingOffset ? ((60.0 / bpm) * 4) : 0.0;
+			if (not chart) throw Error{ U"Failed to load beatmap: {}"_fmt(path) };
 
-		for (auto && obj : json[U"notes"].arrayView()) {
-			//Console << obj;
-			NoteType type = static_cast<NoteType>(obj[U"type"].get<int32>() - 1);
-			int32 lane = obj[U"block"].get<int32>();
+			build(*chart, timingOffset);
+		}
+		else {
+			build(BeatmapBinary::FromJson(JSON::Load(Resource(path))), timingOffset);
+		}
+	}
+
+	Beatmap(const BeatmapBinary::Chart& chart, double _length, bool timingOffset = true) : length{ _length } {
+		build(chart, timingOffset);
+	}
 
-			double timing = Note::GetTimingFromJson(obj, bpm);
+	/// @brief .cbmをメモリマップで開く
+	/// @param binaryPath .cbmのパス
+	/// @param _length 曲の長さ
+	/// @param timingOffset 先頭に4拍分の猶予を入れるか
+	/// @return 開けなかった場合none
+	/// @remark ノーツはコピーせず、マッピングから直接読む
+	static Optional<Beatmap> Map(const FilePath& binaryPath, double _length, bool timingOffset = true) {
+		auto mapping = BeatmapMapping::Open(binaryPath);
 
-			if (type == NoteType::Hold) {
-				maxCombo += 2;
-				notes << Note::Make(type, lane, offset + timing, Note::GetTimingFromJson(obj[U"notes"][0], bpm) - timing, 1.0);
+		if (not mapping) return none;
+
+		Beatmap beatmap;
+
+		beatmap.length = _length;
+		beatmap.bpm = mapping->header().bpm;
+		beatmap.offset = ResolveOffset(mapping->header().offset, beatmap.bpm, timingOffset);
+		beatmap.maxCombo = static_cast<size_t>(mapping->header().maxCombo);
+		beatmap.laneCount = static_cast<int32>(mapping->header().laneCount);
+		beatmap.mapping = std::move(mapping);
+
+		return beatmap;
+	}
+
+	/// @brief ディスク上の.cbmはメモリマップで、埋め込みの.cbmは読み込みで、なければJSONを読み込む
+	/// @remark 変換した後にJSONを書き換えた.cbmは使わない
+	/// JSONの解析結果は内容のハッシュをキーにキャッシュし、変更がなければ次回から解析しない
+	/// @param jsonPath JSONの譜面パス
+	/// @param _length 曲の長さ
+	/// @param timingOffset 先頭に4拍分の猶予を入れるか
+	/// @return Beatmap
+	static Beatmap Load(const FilePath& jsonPath, double _length, bool timingOffset = true) {
+		const FilePath binaryPath = BeatmapBinary::GetBinaryPath(jsonPath);
+
+		if (FileSystem::Exists(binaryPath)) {
+			if (auto beatmap = Map(binaryPath, _length, timingOffset)) {
+				if (BeatmapBinary::IsUpToDate(beatmap->mapping->header(), binaryPath, jsonPath)) {
+					return std::move(*beatmap);
+				}
 			}
-			else {
-				maxCombo += 1;
-				notes << Note::Make(type, lane, offset + timing, 1.0);
+		}
+
+		// マップできなかった.cbm(埋め込み・並べ直しが必要なもの)は読み込み、読めないか古ければJSONを使う
+		if (FileSystem::Exists(Resource(binaryPath))) {
+			if (const auto chart = BeatmapBinary::Load(Resource(binaryPath))) {
+				if (BeatmapBinary::IsUpToDate(chart->header, Resource(binaryPath), Resource(jsonPath))) {
+					return Beatmap{ *chart, _length, timingOffset };
+				}
 			}
+
+			Logger << U"Invalid or outdated beatmap binary, falling back to JSON: {}"_fmt(binaryPath);
 		}
+
+		const Blob source{ Resource(jsonPath) };
+		const FilePath cachePath = BeatmapCache::GetEntryPath(jsonPath, source);
+
+		if (FileSystem::Exists(cachePath)) {
+			if (auto beatmap = Map(cachePath, _length, timingOffset)) {
+				return std::move(*beatmap);
+			}
+		}
+
+		const BeatmapBinary::Chart chart = BeatmapBinary::FromJson(BeatmapCache::Parse(source));
+
+		if (not BeatmapCache::Store(cachePath, chart)) {
+			Logger << U"Failed to write beatmap cache: {}"_fmt(cachePath);
+		}
+
+		return Beatmap{ chart, _length, timingOffset };
+	}
+
+	/// @return 譜面の先頭の時間(マイクロ秒)
+	static int64 ResolveOffset(double offsetMs, double _bpm, bool timingOffset) {
+		// 既存の譜面のタイミングを変えないよう、元の式の評価順のままにしている
+		return Timeline::FromSec((offsetMs / 1000) +
+			timingOffset ? ((60.0 / _bpm) * 4) : 0.0);
+	}
+
+	void build(const BeatmapBinary::Chart& chart, bool timingOffset) {
+		bpm = chart.header.bpm;
+		offset = ResolveOffset(chart.header.offset, bpm, timingOffset);
+		maxCombo = static_cast<size_t>(chart.header.maxCombo);
+		laneCount = static_cast<int32>(chart.header.laneCount);
+
+		chartRecords = chart.records;
+	}
+
+	/// @brief 譜面のすべてのノーツ(時間順)
+	std::span<const BeatmapBinary::NoteRecord> records() const noexcept {
+		if (not mapping) return chartRecords;
+
+		return mapping->records();
+	}
+
+	inline bool isMapped() const noexcept {
+		return static_cast<bool>(mapping);
 	}
 
 	operator bool() const {
-		return not json.isEmpty();
+		return 0.0 < bpm;
 	}
 };
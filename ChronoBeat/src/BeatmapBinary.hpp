@@ -0,0 +1,210 @@
+﻿#pragma once
+#include "Note.hpp"
+
+/// @brief 事前コンパイル済み譜面(.cbm)
+/// @remark JSONを介さずに読み込めるよう、タイミングは解決済みのマイクロ秒で保持する
+namespace BeatmapBinary {
+	inline constexpr std::array<char, 4> Magic{ 'C', 'B', 'M', 'P' };
+	// 4: ヘッダに変換元のJSONの大きさを持つ
+	inline constexpr uint32 Version = 4;
+
+	inline constexpr StringView Extension = U"cbm";
+
+	struct Header {
+		std::array<char, 4> magic = Magic;
+		uint32 version = Version;
+
+		double bpm = 0.0;
+
+		/// @brief JSONの "offset" (ms)
+		double offset = 0.0;
+
+		uint64 maxCombo = 0;
+		uint64 noteCount = 0;
+
+		/// @brief JSONの "lanes" (省略時は4)
+		uint32 laneCount = Globals::defaultLaneNum;
+
+		/// @brief 変換元のJSONの大きさ(バイト), キャッシュでは使わないので0
+		uint32 sourceSize = 0;
+	};
+
+	struct NoteRecord {
+		/// @brief 始点の時間(offsetを含まないマイクロ秒)
+		int64 timing = 0;
+
+		/// @brief Holdの長さ(マイクロ秒), Hold以外は0
+		int64 length = 0;
+
+		uint8 type = 0;
+		uint8 lane = 0;
+
+		std::array<uint8, 6> reserved{};
+
+		NoteType getType() const {
+			return static_cast<NoteType>(type);
+		}
+
+		friend bool operator==(const NoteRecord&, const NoteRecord&) = default;
+	};
+
+	static_assert(sizeof(Header) == 48);
+	static_assert(sizeof(NoteRecord) == 24);
+
+	struct Chart {
+		Header header;
+		Array<NoteRecord> records;
+	};
+
+	/// @brief レーン数が対応しているものか
+	inline bool IsValidLaneCount(const Header& header) {
+		return Globals::IsSupportedLaneCount(header.laneCount);
+	}
+
+	/// @brief ノーツの種類が既知で、譜面のレーンに収まっているか
+	inline bool IsValidRecord(const NoteRecord& record, const Header& header) {
+		return (record.type <= static_cast<uint8>(NoteType::Stay)) && (record.lane < header.laneCount);
+	}
+
+	/// @brief JSONの譜面からタイミングを解決したChartを作る
+	/// @remark ノーツは時間順に並べ替えられる
+	/// 対応していないレーン数や、レーンに収まらないノーツがあれば例外を投げる
+	/// @param json 譜面のJSON
+	/// @return Chart
+	inline Chart FromJson(const JSON& json) {
+		Chart chart;
+
+		const double bpm = json[U"BPM"].get<double>();
+
+		chart.header.bpm = bpm;
+		chart.header.offset = json[U"offset"].get<double>();
+
+		if (json.hasElement(U"lanes")) {
+			const int64 lanes = json[U"lanes"].get<int64>();
+
+			if (not Globals::IsSupportedLaneCount(lanes)) throw Error{ U"Unsupported lane count: {}"_fmt(lanes) };
+
+			chart.header.laneCount = static_cast<uint32>(lanes);
+		}
+
+		for (auto&& obj : json[U"notes"].arrayView()) {
+			NoteRecord record;
+
+			const int32 typeNumber = obj[U"type"].get<int32>();
+			const int32 lane = obj[U"block"].get<int32>();
+
+			if (not InRange(typeNumber, 1, static_cast<int32>(NoteType::Stay) + 1)) {
+				throw Error{ U"Unknown note type: {}"_fmt(typeNumber) };
+			}
+
+			const NoteType type = static_cast<NoteType>(typeNumber - 1);
+
+			if (not InRange<int64>(lane, 0, chart.header.laneCount - 1)) {
+				throw Error{ U"Note block {} is out of {} lanes"_fmt(lane, chart.header.laneCount) };
+			}
+
+			record.type = static_cast<uint8>(type);
+			record.lane = static_cast<uint8>(lane);
+			record.timing = Note::GetTimingFromJson(obj, bpm);
+
+			if (type == NoteType::Hold) {
+				chart.header.maxCombo += 2;
+				record.length = Note::GetTimingFromJson(obj[U"notes"][0], bpm) - record.timing;
+			}
+			else {
+				chart.header.maxCombo += 1;
+			}
+
+			chart.records << record;
+		}
+
+		// 再生中に先頭から順に読めるよう時間順にしておく
+		chart.records.stable_sort_by([](const NoteRecord& a, const NoteRecord& b) {
+			return a.timing < b.timing;
+		});
+
+		chart.header.noteCount = chart.records.size();
+
+		return chart;
+	}
+
+	/// @brief .cbmファイルを読み込む
+	/// @param path ファイルパス(Resource解決済み)
+	/// @return 読み込めなかった場合none
+	inline Optional<Chart> Load(const FilePath& path) {
+		BinaryReader reader{ path };
+
+		if (not reader) return none;
+
+		Chart chart;
+
+		if (not reader.read(chart.header)) return none;
+		if (chart.header.magic != Magic) return none;
+		if (chart.header.version != Version) return none;
+		if (not IsValidLaneCount(chart.header)) return none;
+
+		// noteCount * sizeof(NoteRecord) が桁あふれしないよう、残りの大きさから数で比べる
+		const int64 remaining = reader.size() - reader.getPos();
+
+		if (remaining < 0 || static_cast<uint64>(remaining) / sizeof(NoteRecord) < chart.header.noteCount) return none;
+
+		const int64 bytes = static_cast<int64>(chart.header.noteCount * sizeof(NoteRecord));
+
+		chart.records.resize(static_cast<size_t>(chart.header.noteCount));
+
+		if (reader.read(chart.records.data(), bytes) != bytes) return none;
+
+		if (not chart.records.all([&](const NoteRecord& record) { return IsValidRecord(record, chart.header); })) return none;
+
+		// 再生は先頭から順に読むので、時間順でないファイル(古い変換器のもの)は並べ直す
+		if (not std::ranges::is_sorted(chart.records, {}, &NoteRecord::timing)) {
+			chart.records.stable_sort_by([](const NoteRecord& a, const NoteRecord& b) {
+				return a.timing < b.timing;
+			});
+		}
+
+		return chart;
+	}
+
+	/// @brief .cbmファイルに書き出す
+	/// @param path 書き出し先
+	/// @param chart Chart
+	/// @return 成功したらtrue
+	inline bool Save(const FilePath& path, const Chart& chart) {
+		BinaryWriter writer{ path };
+
+		if (not writer) return false;
+
+		Header header = chart.header;
+		header.noteCount = chart.records.size();
+
+		writer.write(header);
+		writer.write(chart.records.data(), static_cast<int64>(chart.records.size_bytes()));
+
+		return true;
+	}
+
+	/// @brief .cbmが変換元のJSONから作り直さなくてよいものか
+	/// @remark JSONは解析せず、大きさが変換したときと違うか、JSONのほうが新しければ古いとみなす
+	/// @param header .cbmのヘッダ
+	/// @param binaryPath .cbmのパス
+	/// @param jsonPath 変換元のJSON
+	inline bool IsUpToDate(const Header& header, const FilePath& binaryPath, const FilePath& jsonPath) {
+		// .cbmだけを置いたもの
+		if (not FileSystem::Exists(jsonPath)) return true;
+
+		if (static_cast<int64>(header.sourceSize) != FileSystem::FileSize(jsonPath)) return false;
+
+		const Optional<DateTime> jsonTime = FileSystem::WriteTime(jsonPath);
+		const Optional<DateTime> binaryTime = FileSystem::WriteTime(binaryPath);
+
+		return not (jsonTime && binaryTime && (*binaryTime < *jsonTime));
+	}
+
+	/// @brief JSONの譜面パスから対応する.cbmのパスを得る
+	inline FilePath GetBinaryPath(const FilePath& jsonPath) {
+		const size_t pos = jsonPath.lastIndexOf(U'.');
+
+		return U"{}.{}"_fmt((pos == String::npos) ? jsonPath : jsonPath.substr(0, pos), Extension);
+	}
+}
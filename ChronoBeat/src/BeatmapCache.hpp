@@ -0,0 +1,57 @@
+﻿#pragma once
+#include "BeatmapBinary.hpp"
+
+/// @brief JSON譜面を解析した結果(.cbm)のディスクキャッシュ
+/// @remark キーは JSON の内容のハッシュなので、変更された譜面は自分のエントリだけが無効になる
+namespace BeatmapCache {
+	inline const FilePath Directory = U"cache/beatmap";
+
+	/// @brief 譜面ごとのキャッシュディレクトリ
+	inline FilePath GetEntryDirectory(const FilePath& jsonPath) {
+		return FileSystem::PathAppend(Directory, MD5::FromText(jsonPath).asString());
+	}
+
+	/// @brief 譜面の内容に対応するキャッシュのパス
+	/// @param jsonPath JSONの譜面パス
+	/// @param source JSONの内容
+	inline FilePath GetEntryPath(const FilePath& jsonPath, const Blob& source) {
+		const String hash = MD5::FromBinary(source.data(), source.size()).asString();
+
+		return FileSystem::PathAppend(GetEntryDirectory(jsonPath), U"{}.v{}.{}"_fmt(hash, BeatmapBinary::Version, BeatmapBinary::Extension));
+	}
+
+	/// @brief 読み込んだJSONの内容を解析する
+	inline JSON Parse(const Blob& source) {
+		String text = Unicode::FromUTF8(std::string_view{ reinterpret_cast<const char*>(source.data()), source.size() });
+
+		// BOM
+		if (text.starts_with(U'\uFEFF')) text.pop_front();
+
+		return JSON::Parse(text);
+	}
+
+	/// @brief キャッシュを書き込み、同じ譜面の古いキャッシュを消す
+	/// @param entryPath GetEntryPath() で得たパス
+	/// @param chart 解析結果
+	/// @return 書き込めたらtrue
+	inline bool Store(const FilePath& entryPath, const BeatmapBinary::Chart& chart) {
+		const FilePath entryDirectory = FileSystem::ParentPath(entryPath);
+
+		if (FileSystem::Exists(entryDirectory)) {
+			for (const FilePath& old : FileSystem::DirectoryContents(entryDirectory, Recursive::No)) {
+				// 再生中でメモリマップされているものは消せないが、次回以降に消える
+				FileSystem::Remove(old);
+			}
+		}
+		else {
+			FileSystem::CreateDirectories(entryDirectory);
+		}
+
+		// 途中で落ちても壊れたキャッシュが残らないよう、書き終えてから名前を変える
+		const FilePath temporaryPath = entryPath + U".tmp";
+
+		if (not BeatmapBinary::Save(temporaryPath, chart)) return false;
+
+		return FileSystem::Rename(temporaryPath, entryPath);
+	}
+}
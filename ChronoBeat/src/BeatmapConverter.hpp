@@ -0,0 +1,60 @@
+﻿#pragma once
+#include "BeatmapBinary.hpp"
+
+/// @brief beatmap/<song>/{easy,normal,hard,chronos}.json を .cbm に変換する
+namespace BeatmapConverter {
+	inline const Array<FilePath> BeatmapNames{
+		U"easy.json",
+		U"normal.json",
+		U"hard.json",
+		U"chronos.json"
+	};
+
+	/// @brief 1譜面を変換する
+	/// @param jsonPath 変換元のJSON
+	/// @return 成功したらtrue
+	inline bool Convert(const FilePath& jsonPath) {
+		const JSON json = JSON::Load(jsonPath);
+
+		if (not json) return false;
+
+		try {
+			BeatmapBinary::Chart chart = BeatmapBinary::FromJson(json);
+
+			// 読み込むときにJSONが変わっていないか確かめる
+			chart.header.sourceSize = static_cast<uint32>(FileSystem::FileSize(jsonPath));
+
+			return BeatmapBinary::Save(BeatmapBinary::GetBinaryPath(jsonPath), chart);
+		}
+		catch (const Error& error) {
+			Logger << U"Invalid beatmap: {}: {}"_fmt(jsonPath, error.what());
+			return false;
+		}
+	}
+
+	/// @brief baseDir以下の全曲の譜面を変換する
+	/// @param baseDir 譜面のディレクトリ
+	/// @return 変換した譜面の数
+	inline size_t ConvertAll(const FilePath& baseDir) {
+		size_t converted = 0;
+
+		for (const FilePath& songDir : FileSystem::DirectoryContents(baseDir, Recursive::No)) {
+			if (not FileSystem::IsDirectory(songDir)) continue;
+
+			for (const FilePath& name : BeatmapNames) {
+				const FilePath jsonPath = FileSystem::PathAppend(songDir, name);
+
+				if (not FileSystem::Exists(jsonPath)) continue;
+
+				if (Convert(jsonPath)) {
+					converted += 1;
+				}
+				else {
+					Logger << U"Failed to convert: {}"_fmt(jsonPath);
+				}
+			}
+		}
+
+		return converted;
+	}
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+#include <mutex>
+#include <span>
+
+#include "BeatmapBinary.hpp"
+
+/// @brief メモリマップした.cbmファイル
+/// @remark ノーツはマップした領域から直接読み、コピーしない。開くときに1度だけ全ノーツを検証する
+class BeatmapMapping {
+	MemoryMappedFileView m_file;
+	MemoryMappedFileView::MappedMemory m_memory;
+
+	const BeatmapBinary::Header* m_header = nullptr;
+	std::span<const BeatmapBinary::NoteRecord> m_records;
+
+	static inline std::mutex s_mutex;
+	static inline HashTable<FilePath, std::weak_ptr<const BeatmapMapping>> s_opened;
+
+	bool open(const FilePath& path) {
+		if (not m_file.open(path)) return false;
+
+		m_memory = m_file.mapAll();
+
+		if (m_memory.data == nullptr) return false;
+		if (m_memory.size < sizeof(BeatmapBinary::Header)) return false;
+
+		m_header = reinterpret_cast<const BeatmapBinary::Header*>(m_memory.data);
+
+		if (m_header->magic != BeatmapBinary::Magic) return false;
+		if (m_header->version != BeatmapBinary::Version) return false;
+		if (not BeatmapBinary::IsValidLaneCount(*m_header)) return false;
+
+		const size_t noteCount = static_cast<size_t>(m_header->noteCount);
+
+		if ((m_memory.size - sizeof(BeatmapBinary::Header)) / sizeof(BeatmapBinary::NoteRecord) < noteCount) return false;
+
+		m_records = {
+			reinterpret_cast<const BeatmapBinary::NoteRecord*>(m_memory.data + sizeof(BeatmapBinary::Header)),
+			noteCount
+		};
+
+		// 壊れたファイルのノーツを判定に渡さない
+		for (const auto& record : m_records) {
+			if (not BeatmapBinary::IsValidRecord(record, *m_header)) return false;
+		}
+
+		// マップした記録は並べ替えられないので、時間順でなければ開かない(Beatmap::Load は読み込みに切り替える)
+		if (not std::ranges::is_sorted(m_records, {}, &BeatmapBinary::NoteRecord::timing)) return false;
+
+		return true;
+	}
+
+public:
+	BeatmapMapping() = default;
+
+	BeatmapMapping(const BeatmapMapping&) = delete;
+	BeatmapMapping& operator=(const BeatmapMapping&) = delete;
+
+	~BeatmapMapping() {
+		m_file.unmap();
+	}
+
+	/// @brief .cbmファイルをメモリマップで開く
+	/// @param path ファイルパス(埋め込みリソースは不可)
+	/// @remark 同じファイルを開いている間は同じマッピングを共有する
+	/// @return 開けなかった場合nullptr
+	static std::shared_ptr<const BeatmapMapping> Open(const FilePath& path) {
+		if (FileSystem::IsResource(path)) return nullptr;
+
+		const FilePath fullPath = FileSystem::FullPath(path);
+
+		std::lock_guard lock{ s_mutex };
+
+		if (auto it = s_opened.find(fullPath); it != s_opened.end()) {
+			if (auto mapping = it->second.lock()) return mapping;
+		}
+
+		auto mapping = std::make_shared<BeatmapMapping>();
+
+		if (not mapping->open(fullPath)) return nullptr;
+
+		s_opened[fullPath] = mapping;
+
+		return mapping;
+	}
+
+	const BeatmapBinary::Header& header() const noexcept {
+		return *m_header;
+	}
+
+	std::span<const BeatmapBinary::NoteRecord> records() const noexcept {
+		return m_records;
+	}
+};
@@ -0,0 +1,275 @@
+﻿#pragma once
+#include <atomic>
+#include <numeric>
+
+#include "Beatmap.hpp"
+#include "BeatmapConverter.hpp"
+
+/// @brief 譜面ライブラリの全譜面を全コアで並列に検証し、正規化した譜面を書き出す
+/// @remark コマンドライン(--validate-beatmaps)から実行する。結果はコンソールと validation.txt に出力する
+namespace BeatmapValidator {
+	inline const FilePath ReportPath = U"validation.txt";
+
+	struct Result {
+		FilePath path;
+
+		Array<String> errors;
+		Array<String> warnings;
+
+		/// @brief 正規化した譜面(エラーがあるときはnone)
+		Optional<JSON> normalized;
+	};
+
+	/// @brief 1ノーツ分の LPB/num を検証する
+	/// @param obj ノーツ(Holdの終点も含む)
+	/// @param where エラーの表示用
+	inline bool ValidateTiming(const JSON& obj, const String& where, Array<String>& errors) {
+		if (not obj[U"LPB"].isInteger() || obj[U"LPB"].get<int32>() <= 0) {
+			errors << U"{}: LPB must be a positive integer ({})"_fmt(where, obj[U"LPB"].formatMinimum());
+			return false;
+		}
+
+		if (not obj[U"num"].isInteger() || obj[U"num"].get<int32>() < 0) {
+			errors << U"{}: num must be a non-negative integer ({})"_fmt(where, obj[U"num"].formatMinimum());
+			return false;
+		}
+
+		return true;
+	}
+
+	/// @brief 譜面を検証する
+	/// @param json 譜面のJSON
+	/// @param result 結果の出力先
+	inline void Validate(const JSON& json, Result& result) {
+		auto& errors = result.errors;
+
+		if (not json[U"BPM"].isNumber() || json[U"BPM"].get<double>() <= 0.0) {
+			errors << U"BPM must be a positive number";
+			return;
+		}
+
+		if (not json[U"offset"].isNumber()) {
+			errors << U"offset must be a number";
+			return;
+		}
+
+		if (not json[U"notes"].isArray()) {
+			errors << U"notes must be an array";
+			return;
+		}
+
+		int32 laneCount = Globals::defaultLaneNum;
+
+		if (json.hasElement(U"lanes")) {
+			if (not json[U"lanes"].isInteger() || not Globals::IsSupportedLaneCount(json[U"lanes"].get<int64>())) {
+				errors << U"lanes must be one of {} ({})"_fmt(Array<int32>(Globals::laneCounts.begin(), Globals::laneCounts.end()), json[U"lanes"].formatMinimum());
+				return;
+			}
+
+			laneCount = json[U"lanes"].get<int32>();
+		}
+
+		const double bpm = json[U"BPM"].get<double>();
+		const double offsetMs = json[U"offset"].get<double>();
+
+		// Beatmap::ResolveOffset は三項演算子の優先順位のため offset を無視している
+		if (const int64 resolved = Beatmap::ResolveOffset(offsetMs, bpm, true), intended = Timeline::FromSec((offsetMs / 1000) + ((60.0 / bpm) * 4));
+			resolved != intended) {
+			result.warnings << U"offset {}ms is ignored by Beatmap::ResolveOffset (resolved {:.3f}s, intended {:.3f}s)"_fmt(offsetMs, Timeline::ToSec(resolved), Timeline::ToSec(intended));
+		}
+
+		// 始点・終点(マイクロ秒)とレーン
+		struct Span {
+			int64 begin;
+			int64 end;
+			size_t index;
+		};
+
+		Array<Array<Span>> lanes(laneCount);
+
+		const JSON& notes = json[U"notes"];
+
+		for (size_t i = 0; i < notes.size(); ++i) {
+			const JSON& obj = notes[i];
+			const String where = U"notes[{}]"_fmt(i);
+
+			if (not obj[U"type"].isInteger()
+				|| not InRange(obj[U"type"].get<int32>(), static_cast<int32>(NoteType::Tap) + 1, static_cast<int32>(NoteType::Stay) + 1)) {
+				errors << U"{}: unknown type ({})"_fmt(where, obj[U"type"].formatMinimum());
+				continue;
+			}
+
+			if (not obj[U"block"].isInteger() || not InRange(obj[U"block"].get<int32>(), 0, laneCount - 1)) {
+				errors << U"{}: block is out of lanes ({})"_fmt(where, obj[U"block"].formatMinimum());
+				continue;
+			}
+
+			if (not ValidateTiming(obj, where, errors)) continue;
+
+			const NoteType type = static_cast<NoteType>(obj[U"type"].get<int32>() - 1);
+			const int64 begin = Note::GetTimingFromJson(obj, bpm);
+			int64 end = begin;
+
+			if (type == NoteType::Hold) {
+				const JSON& tail = obj[U"notes"];
+
+				if (not tail.isArray() || tail.size() == 0) {
+					errors << U"{}: hold has no end"_fmt(where);
+					continue;
+				}
+
+				if (not ValidateTiming(tail[0], where + U".notes[0]", errors)) continue;
+
+				end = Note::GetTimingFromJson(tail[0], bpm);
+
+				if (end <= begin) {
+					errors << U"{}: hold ends ({:.3f}s) before it starts ({:.3f}s)"_fmt(where, Timeline::ToSec(end), Timeline::ToSec(begin));
+					continue;
+				}
+			}
+
+			lanes[obj[U"block"].get<int32>()] << Span{ begin, end, i };
+		}
+
+		for (auto&& [lane, spans] : Indexed(lanes)) {
+			spans.stable_sort_by([](const Span& a, const Span& b) { return a.begin < b.begin; });
+
+			for (size_t i = 1; i < spans.size(); ++i) {
+				const Span& prev = spans[i - 1];
+				const Span& current = spans[i];
+
+				if (current.begin <= prev.end) {
+					errors << U"notes[{}] overlaps notes[{}] in lane {} at {:.3f}s"_fmt(current.index, prev.index, lane, Timeline::ToSec(current.begin));
+				}
+			}
+		}
+	}
+
+	/// @brief ノーツを時間順(同時ならレーン順)に並べた譜面を作る
+	/// @param json 検証済みの譜面のJSON
+	inline JSON Normalize(const JSON& json) {
+		const double bpm = json[U"BPM"].get<double>();
+		const JSON& notes = json[U"notes"];
+
+		Array<size_t> order(notes.size());
+		std::iota(order.begin(), order.end(), size_t{ 0 });
+
+		order.stable_sort_by([&](size_t a, size_t b) {
+			const int64 ta = Note::GetTimingFromJson(notes[a], bpm);
+			const int64 tb = Note::GetTimingFromJson(notes[b], bpm);
+
+			if (ta != tb) return ta < tb;
+
+			return notes[a][U"block"].get<int32>() < notes[b][U"block"].get<int32>();
+		});
+
+		JSON sorted = JSON::Parse(U"[]");
+
+		for (size_t i : order) {
+			sorted.push_back(notes[i]);
+		}
+
+		JSON normalized = json;
+		normalized[U"notes"] = sorted;
+
+		return normalized;
+	}
+
+	/// @brief 1譜面を読み込んで検証する
+	inline Result Run(const FilePath& jsonPath) {
+		Result result{ .path = jsonPath };
+
+		try {
+			const JSON json = JSON::Load(jsonPath);
+
+			if (not json) {
+				result.errors << U"invalid JSON";
+				return result;
+			}
+
+			Validate(json, result);
+
+			if (result.errors.isEmpty()) {
+				result.normalized = Normalize(json);
+			}
+		}
+		catch (const Error& error) {
+			result.errors << String{ error.what() };
+		}
+
+		return result;
+	}
+
+	/// @brief baseDir以下の全曲の譜面を検証する
+	/// @param baseDir 譜面のディレクトリ
+	/// @param outputDir 正規化した譜面の書き出し先(空なら書き出さない)
+	/// @return エラーのあった譜面の数
+	inline size_t ValidateAll(const FilePath& baseDir, const FilePath& outputDir) {
+		const Stopwatch stopwatch{ StartImmediately::Yes };
+
+		Array<FilePath> paths;
+
+		for (const FilePath& songDir : FileSystem::DirectoryContents(baseDir, Recursive::No)) {
+			if (not FileSystem::IsDirectory(songDir)) continue;
+
+			for (const FilePath& name : BeatmapConverter::BeatmapNames) {
+				if (const FilePath jsonPath = FileSystem::PathAppend(songDir, name); FileSystem::Exists(jsonPath)) {
+					paths << jsonPath;
+				}
+			}
+		}
+
+		Array<Result> results(paths.size());
+		std::atomic<size_t> next = 0;
+
+		// 1譜面ずつ空いたワーカーが取っていく
+		{
+			Array<AsyncTask<void>> workers;
+
+			for ([[maybe_unused]] size_t i : step(Clamp<size_t>(Threading::GetConcurrency(), 1, Max<size_t>(paths.size(), 1)))) {
+				workers << Async([&] {
+					for (size_t k = next++; k < paths.size(); k = next++) {
+						results[k] = Run(paths[k]);
+
+						if (results[k].normalized && not outputDir.isEmpty()) {
+							const FilePath outputPath = FileSystem::PathAppend(outputDir, FileSystem::RelativePath(paths[k], baseDir));
+
+							FileSystem::CreateDirectories(FileSystem::ParentPath(outputPath));
+
+							if (not results[k].normalized->save(outputPath)) {
+								results[k].errors << U"failed to write {}"_fmt(outputPath);
+							}
+						}
+					}
+				});
+			}
+
+			for (auto& worker : workers) {
+				worker.wait();
+			}
+		}
+
+		TextWriter writer{ ReportPath };
+
+		const auto writeln = [&](const String& line) {
+			Console << line;
+			writer.writeln(line);
+		};
+
+		size_t failed = 0;
+		size_t warned = 0;
+
+		for (const auto& result : results) {
+			for (const auto& error : result.errors) writeln(U"error: {}: {}"_fmt(result.path, error));
+			for (const auto& warning : result.warnings) writeln(U"warning: {}: {}"_fmt(result.path, warning));
+
+			if (not result.errors.isEmpty()) ++failed;
+			if (not result.warnings.isEmpty()) ++warned;
+		}
+
+		writeln(U"{} beatmap(s), {} failed, {} with warnings ({:.0f}ms)"_fmt(results.size(), failed, warned, stopwatch.msF()));
+		writeln((0 < failed) ? U"FAILED" : U"OK");
+
+		return failed;
+	}
+}
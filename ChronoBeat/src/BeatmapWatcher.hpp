@@ -0,0 +1,130 @@
+﻿#pragma once
+#include "Beatmap.hpp"
+
+/// @brief 譜面の変更点
+struct BeatmapPatch {
+	/// @brief 変更後のヘッダ
+	BeatmapBinary::Header header;
+
+	/// @brief 変更前後の offset (Beatmap::ResolveOffset 済み)
+	int64 oldOffset = 0;
+	int64 newOffset = 0;
+
+	/// @brief 消えたノーツ(変更前の譜面での記録)
+	Array<BeatmapBinary::NoteRecord> removed;
+
+	/// @brief 増えたノーツ(変更後の譜面での記録)
+	Array<BeatmapBinary::NoteRecord> added;
+};
+
+/// @brief 譜面制作用: JSON譜面の保存を監視して、変わった範囲のノーツだけを返す
+class BeatmapWatcher {
+	/// @brief 保存が続いている間は読み込まない
+	static constexpr double DebounceSec = 0.2;
+
+	FilePath m_path;
+	bool m_timingOffset = true;
+
+	DirectoryWatcher m_watcher;
+
+	Optional<BeatmapBinary::Chart> m_chart;
+	Optional<AsyncTask<BeatmapBinary::Chart>> m_parseTask;
+
+	Stopwatch m_debounce{ StartImmediately::No };
+
+	static BeatmapBinary::Chart Parse(const FilePath& path) {
+		return BeatmapBinary::FromJson(JSON::Load(path));
+	}
+
+	/// @brief 先頭と末尾から同じ記録を除いた残りを差分とする
+	/// @remark 記録は時間順なので、譜面の一部を編集した場合はその付近だけが差分になる
+	BeatmapPatch diff(const BeatmapBinary::Chart& before, const BeatmapBinary::Chart& after) const {
+		BeatmapPatch patch;
+
+		patch.header = after.header;
+		patch.oldOffset = Beatmap::ResolveOffset(before.header.offset, before.header.bpm, m_timingOffset);
+		patch.newOffset = Beatmap::ResolveOffset(after.header.offset, after.header.bpm, m_timingOffset);
+
+		const auto& a = before.records;
+		const auto& b = after.records;
+
+		size_t prefix = 0;
+		size_t suffix = 0;
+
+		// BPM・offset が変わったときは全ノーツのタイミングが変わる
+		if (before.header.bpm == after.header.bpm && patch.oldOffset == patch.newOffset) {
+			while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix]) ++prefix;
+
+			while (suffix < (a.size() - prefix) && suffix < (b.size() - prefix)
+				&& a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix]) ++suffix;
+		}
+
+		patch.removed.assign(a.begin() + prefix, a.end() - suffix);
+		patch.added.assign(b.begin() + prefix, b.end() - suffix);
+
+		return patch;
+	}
+
+public:
+	BeatmapWatcher() = default;
+
+	/// @param jsonPath 監視するJSON譜面(ディスク上のファイルのみ)
+	/// @param timingOffset Beatmap と同じ値
+	BeatmapWatcher(const FilePath& jsonPath, bool timingOffset = true) :
+		m_path{ FileSystem::FullPath(jsonPath) },
+		m_timingOffset{ timingOffset },
+		m_watcher{ FileSystem::ParentPath(m_path) } {
+		// 差分の基準
+		m_parseTask = Async(Parse, m_path);
+	}
+
+	/// @brief 監視できているか
+	bool isActive() const {
+		return m_watcher.isActive();
+	}
+
+	/// @brief 保存を検知して読み直し、変更があれば差分を返す(毎フレーム呼ぶ)
+	Optional<BeatmapPatch> update() {
+		for (auto&& change : m_watcher.retrieveChanges()) {
+			if (change.action == FileAction::Removed || change.action == FileAction::RenamedOldName) continue;
+
+			if (FileSystem::FullPath(change.path) == m_path) {
+				m_debounce.restart();
+			}
+		}
+
+		if (m_debounce.isRunning() && DebounceSec <= m_debounce.sF() && not m_parseTask) {
+			m_debounce.reset();
+			m_parseTask = Async(Parse, m_path);
+		}
+
+		if (not m_parseTask || not m_parseTask->isReady()) return none;
+
+		Optional<BeatmapBinary::Chart> chart;
+
+		try {
+			chart = m_parseTask->get();
+		}
+		catch (const Error& error) {
+			// 保存途中などで読めなかったときは次の保存を待つ
+			Logger << U"Failed to reload beatmap: {}"_fmt(error.what());
+		}
+
+		m_parseTask.reset();
+
+		if (not chart) return none;
+
+		if (not m_chart) {
+			m_chart = std::move(chart);
+			return none;
+		}
+
+		BeatmapPatch patch = diff(*m_chart, *chart);
+
+		m_chart = std::move(chart);
+
+		if (patch.removed.isEmpty() && patch.added.isEmpty() && patch.oldOffset == patch.newOffset) return none;
+
+		return patch;
+	}
+};
@@ -0,0 +1,481 @@
+﻿#pragma once
+#include <Siv3D.hpp>
+#include <Siv3D/Windows/Windows.hpp>
+#include <Psapi.h>
+
+#include "Beatmap.hpp"
+#include "GameManager.hpp"
+#include "SongInfo.hpp"
+
+/// @brief コマンドライン(--bench-*)から実行する計測
+/// @remark 結果はコンソールと benchmark.txt に出力する
+namespace Benchmark {
+	inline const FilePath ReportPath = U"benchmark.txt";
+
+	/// @brief 計測結果の出力先
+	struct Report {
+		TextWriter writer{ ReportPath, OpenMode::Append };
+
+		Report(StringView title) {
+			writeln(U"# {} ({})"_fmt(title, DateTime::Now()));
+		}
+
+		void writeln(const String& line) {
+			Console << line;
+			writer.writeln(line);
+		}
+	};
+
+	/// @brief プロセスのワーキングセット(byte)
+	inline size_t ResidentBytes() {
+		PROCESS_MEMORY_COUNTERS counters{};
+
+		if (not ::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+
+		return counters.WorkingSetSize;
+	}
+
+	inline String FormatBytes(int64 bytes) {
+		return U"{:.2f} MiB"_fmt(bytes / (1024.0 * 1024.0));
+	}
+
+	/// @brief 譜面の読み込み方式ごとに、読み込み時間と保持しているメモリを比較する
+	/// @param jsonPath JSONの譜面パス(同じ場所に.cbmが必要)
+	/// @param iterations 読み込む回数
+	inline void BeatmapLoad(const FilePath& jsonPath, int32 iterations = 20) {
+		Report report{ U"Beatmap load: {}"_fmt(jsonPath) };
+
+		const FilePath binaryPath = BeatmapBinary::GetBinaryPath(jsonPath);
+
+		auto measure = [&](StringView name, auto load) {
+			Array<Beatmap> beatmaps;
+			beatmaps.reserve(iterations);
+
+			const size_t before = ResidentBytes();
+			const Stopwatch stopwatch{ StartImmediately::Yes };
+
+			for ([[maybe_unused]] int32 i : step(iterations)) {
+				beatmaps << load();
+			}
+
+			const double ms = stopwatch.msF() / iterations;
+
+			// メモリマップはノーツを読むまでページが載らないので、プレイと同じく全ノーツを読んでから測る
+			int64 checksum = 0;
+
+			for (const auto& beatmap : beatmaps) {
+				for (const auto& record : beatmap.records()) {
+					checksum += record.timing + record.type + record.lane;
+				}
+			}
+
+			const int64 resident = static_cast<int64>(ResidentBytes()) - static_cast<int64>(before);
+
+			report.writeln(U"{:<8} {:>10.3f} ms/load, resident +{} after reading all notes ({} loads, checksum {})"_fmt(name, ms, FormatBytes(resident), iterations, checksum));
+		};
+
+		measure(U"json", [&] { return Beatmap{ jsonPath, 0.0 }; });
+		measure(U"binary", [&] { return Beatmap{ binaryPath, 0.0 }; });
+		measure(U"mapped", [&] { return Beatmap::Map(binaryPath, 0.0).value_or(Beatmap{}); });
+	}
+
+	/// @brief 一定の密度で seconds 秒分のノーツを並べた譜面
+	/// @param seconds 譜面の長さ
+	/// @param notesPerSec 1秒あたりのノーツ数
+	/// @param laneCount レーン数
+	inline BeatmapBinary::Chart MakeSyntheticChart(double seconds, double notesPerSec = 20.0, int32 laneCount = Globals::defaultLaneNum) {
+		BeatmapBinary::Chart chart;
+
+		chart.header.bpm = 120.0;
+		chart.header.laneCount = static_cast<uint32>(laneCount);
+
+		const size_t count = static_cast<size_t>(seconds * notesPerSec);
+
+		chart.records.reserve(count);
+
+		for (size_t i : step(count)) {
+			BeatmapBinary::NoteRecord record;
+
+			record.timing = Timeline::FromSec(i / notesPerSec);
+			record.type = static_cast<uint8>((i % 8 == 7) ? NoteType::Hold : NoteType::Tap);
+			record.lane = static_cast<uint8>(i % laneCount);
+			record.length = (record.getType() == NoteType::Hold) ? Timeline::FromSec(0.25) : 0;
+
+			chart.records << record;
+		}
+
+		chart.header.noteCount = chart.records.size();
+		chart.header.maxCombo = chart.records.size();
+
+		return chart;
+	}
+
+	/// @brief 譜面の長さとレーン数を変えて GameManager::update の1フレームあたりの時間を計測する
+	/// @remark 同じ密度なら、譜面が長くなってもレーン数が増えてもフレーム時間はほぼ変わらないはず
+	/// @param frameRate 1秒あたりのフレーム数
+	/// @param playSeconds 計測する再生時間
+	inline void NoteScheduler(int32 frameRate = 240, double playSeconds = 30.0) {
+		Report report{ U"Note scheduler: {} Hz, {} s"_fmt(frameRate, playSeconds) };
+
+		for (const int32 laneCount : Globals::laneCounts) {
+			for (const double seconds : { 60.0, 240.0, 960.0, 3840.0 }) {
+				const BeatmapBinary::Chart chart = MakeSyntheticChart(seconds, 20.0, laneCount);
+
+				GameManager game{ Beatmap{ chart, seconds } };
+
+				const int32 frames = static_cast<int32>(playSeconds * frameRate);
+				const Stopwatch stopwatch{ StartImmediately::Yes };
+
+				for (int32 frame : step(frames)) {
+					game.update(frame * Timeline::MicrosPerSec / frameRate, Time::GetMicrosec());
+				}
+
+				report.writeln(U"{}K {:>6} notes {:>10.3f} us/frame"_fmt(laneCount, chart.records.size(), stopwatch.usF() / frames));
+			}
+		}
+	}
+
+	/// @brief 比較用: 以前のノーツ(shared_ptr + 仮想関数 + dynamic_cast, 秒の double と HashTable の判定幅・キー)を再現したもの
+	namespace Legacy {
+		inline InputGroup GetControllKey(int32 lane) {
+			return Globals::laneKeys[Globals::defaultLaneNum][lane];
+		}
+
+		/// @brief 計測中にキーを押したこと・押していることにするか(実際のキーの代わり)
+		inline bool isSyntheticDown = false;
+		inline bool isSyntheticPressed = false;
+
+		/// @remark 以前と同じく InputGroup をコピーして読むコストは残す
+		inline bool IsKeyDown(int32 lane) {
+			return GetControllKey(lane).down() || isSyntheticDown;
+		}
+
+		inline bool IsKeyPressed(int32 lane) {
+			return GetControllKey(lane).pressed() || isSyntheticPressed;
+		}
+
+		inline HashTable<JudgeType, int32> JudgeTimings = {
+			{ JudgeType::Perfect, 40 },
+			{ JudgeType::Great, 60 },
+			{ JudgeType::Near, 80 }
+		};
+
+		inline JudgeType GetJudge(double diff) {
+			int32 minTiming = JudgeTimings[JudgeType::Near];
+
+			if (diff * 1000 < -minTiming) return JudgeType::Miss;
+
+			const double adiff = Math::Abs(diff);
+			minTiming += 1;
+
+			JudgeType result = JudgeType::None;
+
+			for (auto&& [type, millis] : JudgeTimings) {
+				if (minTiming <= millis) continue;
+
+				if (adiff * 1000 <= millis) {
+					minTiming = millis;
+					result = type;
+				}
+			}
+
+			return result;
+		}
+
+		struct Note {
+			int32 lane = 0;
+			double timing = 0.0;
+			bool isRemovable = false;
+
+			Note(int32 _lane, double t) : lane{ _lane }, timing{ t } {}
+
+			virtual ~Note() = default;
+
+			[[nodiscard]] virtual JudgeType update(double t) = 0;
+		};
+
+		struct TapNote : Note {
+			using Note::Note;
+
+			JudgeType update(double t) override {
+				const JudgeType result = GetJudge(timing - t);
+
+				if (result == JudgeType::Miss) return result;
+				if (not IsKeyDown(lane)) return JudgeType::None;
+
+				if (result != JudgeType::None) isRemovable = true;
+
+				return result;
+			}
+		};
+
+		struct HoldNote : Note {
+			double length = 0.0;
+			bool isHolding = false;
+
+			HoldNote(int32 _lane, double t, double _length) : Note{ _lane, t }, length{ _length } {}
+
+			JudgeType update(double t) override {
+				const JudgeType result = GetJudge((isHolding ? (timing + length) : timing) - t);
+
+				if (result == JudgeType::Miss) return result;
+				if (not IsKeyDown(lane)) return JudgeType::None;
+
+				if (result != JudgeType::None) isHolding = true;
+
+				return result;
+			}
+		};
+
+		struct StayNote : Note {
+			using Note::Note;
+
+			JudgeType update(double t) override {
+				const JudgeType result = GetJudge(timing - t);
+
+				if (result == JudgeType::Miss) return result;
+				if (not IsKeyPressed(lane)) return JudgeType::None;
+
+				return result;
+			}
+		};
+	}
+
+	/// @brief 以前のノーツと NoteStore とで、全ノーツの更新ループにかかる時間を比較する
+	/// @param seconds 譜面の長さ(1秒あたり20ノーツ)
+	/// @param frameRate 1秒あたりの更新回数
+	/// @remark 1曲を通して実際のフレームの間隔で時間を進める。判定幅に入っているノーツは数個で、
+	/// 0.2秒ごとに全レーンを押して半分の間押し続けるので、間に合わずに Miss になるノーツも出る。判定したノーツは以降飛ばす
+	inline void NoteDispatch(double seconds = 120.0, double frameRate = 240.0) {
+		const BeatmapBinary::Chart chart = MakeSyntheticChart(seconds);
+
+		// 先頭の1秒前から末尾の1秒後まで
+		const int64 beginTime = Timeline::FromSec(-1.0);
+		const int32 frames = static_cast<int32>((seconds + 2.0) * frameRate);
+
+		Report report{ U"Note dispatch: {} notes, {} frames at {} fps"_fmt(chart.records.size(), frames, frameRate) };
+
+		const auto frameTime = [&](int32 frame) {
+			return beginTime + static_cast<int64>(frame * Timeline::MicrosPerSec / frameRate);
+		};
+
+		// PressPeriod フレームごとに押し、半分たったら離す
+		constexpr int32 PressPeriod = 48;
+
+		const auto isDownFrame = [](int32 frame) {
+			return frame % PressPeriod == 0;
+		};
+
+		const auto isUpFrame = [](int32 frame) {
+			return frame % PressPeriod == PressPeriod / 2;
+		};
+
+		const auto isPressedFrame = [](int32 frame) {
+			return frame % PressPeriod < PressPeriod / 2;
+		};
+
+		const auto writeResult = [&](StringView name, double us, size_t hits, size_t misses) {
+			report.writeln(U"{:<8} {:>10.3f} us/frame ({} hits, {} misses)"_fmt(name, us / frames, hits, misses));
+		};
+
+		{
+			Array<std::shared_ptr<Legacy::Note>> notes;
+
+			for (const auto& record : chart.records) {
+				switch (record.getType()) {
+				case NoteType::Hold: notes << std::make_shared<Legacy::HoldNote>(record.lane, Timeline::ToSec(record.timing), Timeline::ToSec(record.length)); break;
+				case NoteType::Stay: notes << std::make_shared<Legacy::StayNote>(record.lane, Timeline::ToSec(record.timing)); break;
+				default: notes << std::make_shared<Legacy::TapNote>(record.lane, Timeline::ToSec(record.timing)); break;
+				}
+			}
+
+			size_t hits = 0;
+			size_t misses = 0;
+			const Stopwatch stopwatch{ StartImmediately::Yes };
+
+			for (int32 frame : step(frames)) {
+				const double t = Timeline::ToSec(frameTime(frame));
+
+				Legacy::isSyntheticDown = isDownFrame(frame);
+				Legacy::isSyntheticPressed = isPressedFrame(frame);
+
+				for (auto&& note : notes) {
+					if (note->isRemovable) continue;
+
+					Legacy::HoldNote* holdNote = dynamic_cast<Legacy::HoldNote*>(note.get());
+					const bool wasHolding = holdNote && holdNote->isHolding;
+
+					const JudgeType judge = note->update(t);
+
+					if (judge == JudgeType::None) continue;
+
+					++((judge == JudgeType::Miss) ? misses : hits);
+
+					// ホールドは始点の判定では残し、終点か Miss で消す
+					if (judge == JudgeType::Miss || not holdNote || wasHolding) note->isRemovable = true;
+				}
+			}
+
+			Legacy::isSyntheticDown = false;
+			Legacy::isSyntheticPressed = false;
+
+			writeResult(U"virtual", stopwatch.usF(), hits, misses);
+		}
+
+		{
+			NoteStore notes;
+			notes.reserve(chart.records.size());
+
+			for (const auto& record : chart.records) {
+				notes.push_back(record.getType(), record.lane, record.timing, record.length);
+			}
+
+			size_t hits = 0;
+			size_t misses = 0;
+			const Stopwatch stopwatch{ StartImmediately::Yes };
+
+			for (int32 frame : step(frames)) {
+				const int64 time = frameTime(frame);
+				const LaneInput input = (isDownFrame(frame) || isUpFrame(frame))
+					? LaneInput::FromEvent(LaneEvent{ time, isDownFrame(frame) })
+					: LaneInput::Holding(isPressedFrame(frame));
+
+				for (size_t i = 0; i < notes.size(); ++i) {
+					if (notes.isRemovable(i)) continue;
+
+					const JudgeType judge = Note::Update<JudgeWindow<JudgePreset::Normal>>(notes, i, time, input);
+
+					if (judge == JudgeType::None) continue;
+
+					++((judge == JudgeType::Miss) ? misses : hits);
+
+					if (judge == JudgeType::Miss) notes.setRemovable(i);
+				}
+			}
+
+			writeResult(U"store", stopwatch.usF(), hits, misses);
+		}
+	}
+
+	/// @brief ノーツ1つずつの計算と NotePosition::CalcY の命令セットごとに、1フレーム分のY座標の計算にかかる時間を比較する
+	/// @param count 1フレームで計算するノーツ数
+	/// @param frames 計算する回数
+	inline void NotePositions(size_t count = 100000, int32 frames = 240) {
+		Report report{ U"Note position: {} notes, {} frames"_fmt(count, frames) };
+
+		const BeatmapBinary::Chart chart = MakeSyntheticChart(count / 20.0);
+
+		Array<int64> timing;
+		Array<int64> length;
+
+		timing.reserve(chart.records.size());
+		length.reserve(chart.records.size());
+
+		for (const auto& record : chart.records) {
+			timing << record.timing;
+			length << record.length;
+		}
+
+		Array<double> headY(timing.size());
+		Array<double> tailY(timing.size());
+
+		const double scroll = 1.0;
+
+		auto writeResult = [&](StringView name, const Stopwatch& stopwatch, double checksum) {
+			const double us = stopwatch.usF() / frames;
+
+			report.writeln(U"{:<8} {:>10.3f} us/frame {:>8.1f} Mpos/s (checksum {:.1f})"_fmt(name, us, (timing.size() * 2) / us, checksum));
+		};
+
+		// 以前の描画と同じく、ノーツごとに始点・終点を計算する
+		{
+			double checksum = 0.0;
+			const Stopwatch stopwatch{ StartImmediately::Yes };
+
+			for (int32 frame : step(frames)) {
+				const int64 t = frame * Timeline::MicrosPerSec / 60;
+
+				for (size_t i = 0; i < timing.size(); ++i) {
+					headY[i] = Note::CalcY(timing[i], t, scroll);
+					tailY[i] = Note::CalcY(timing[i] + length[i], t, scroll);
+				}
+
+				checksum += headY.back() + tailY.back();
+			}
+
+			writeResult(U"per-note", stopwatch, checksum);
+		}
+
+		for (const auto isa : { NotePosition::Isa::Scalar, NotePosition::Isa::SSE2, NotePosition::Isa::AVX2 }) {
+			if (NotePosition::DetectIsa() < isa) {
+				report.writeln(U"{:<8} (not supported)"_fmt(NotePosition::GetIsaName(isa)));
+				continue;
+			}
+
+			double checksum = 0.0;
+			const Stopwatch stopwatch{ StartImmediately::Yes };
+
+			for (int32 frame : step(frames)) {
+				const int64 t = frame * Timeline::MicrosPerSec / 60;
+				const double pixelsPerMicro = NotePosition::PixelsPerMicro(scroll);
+
+				NotePosition::CalcY(timing, {}, t, pixelsPerMicro, headY, isa);
+				NotePosition::CalcY(timing, length, t, pixelsPerMicro, tailY, isa);
+
+				checksum += headY.back() + tailY.back();
+			}
+
+			writeResult(NotePosition::GetIsaName(isa), stopwatch, checksum);
+		}
+	}
+
+	/// @brief songinfo.json の曲を count 曲分になるまで複製して登録し、起動時間とメモリを計測する
+	/// @param count 曲数
+	inline void SongLibraryRegistration(size_t count = 500) {
+		Report report{ U"Song library: {} songs"_fmt(count) };
+
+		const JSON infoJson = JSON::Load(Resource(U"songinfo.json"));
+
+		Array<SongInfo> sources;
+
+		for (const JSON& data : infoJson.arrayView()) {
+			sources << SongInfo{ data };
+		}
+
+		if (sources.isEmpty()) return;
+
+		Array<SongInfo> library;
+		library.reserve(count);
+
+		const size_t before = ResidentBytes();
+		const Stopwatch stopwatch{ StartImmediately::Yes };
+
+		for (size_t i : step(count)) {
+			SongInfo info = sources[i % sources.size()];
+			info.title += U" #{}"_fmt(i);
+
+			library << info.registerAsset();
+		}
+
+		const double registerMs = stopwatch.msF();
+		const int64 registerResident = static_cast<int64>(ResidentBytes()) - static_cast<int64>(before);
+
+		report.writeln(U"register {:>10.3f} ms, resident +{}"_fmt(registerMs, FormatBytes(registerResident)));
+
+		// 最初の1曲を再生できる状態にするまで
+		{
+			const Stopwatch firstPlay{ StartImmediately::Yes };
+
+			const Audio song = AudioAsset(library.front().getSongAssetName());
+
+			report.writeln(U"first song ready {:>10.3f} ms ({:.1f} s)"_fmt(firstPlay.msF(), song.lengthSec()));
+		}
+
+		for (const auto& info : library) {
+			info.releaseSong();
+
+			AudioAsset::Unregister(info.getSongAssetName());
+			TextureAsset::Unregister(info.getJacketAssetName());
+		}
+	}
+}
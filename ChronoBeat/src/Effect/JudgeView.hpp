@@ -3,39 +3,74 @@
 #include "../Globals.hpp"
 
 namespace MyEffect {
-	struct JudgeView : IEffect {
+	/// @brief 判定の表示
+	/// @remark 判定のたびに Effect を確保しないよう、決まった数の枠を使い回す。
+	/// 枠が足りなくなったら最も古い表示を上書きする
+	class JudgeView {
+	public:
 		static constexpr double MaxLifetime = 0.3;
 		static constexpr double FadeTime = 0.1;
-		Transition fadeTransition{ SecondsF{ FadeTime }, SecondsF{ FadeTime } };
 
 		static constexpr int32 FloatHeight = 60;
 
-		Vec2 pos;
+		/// @brief 同時に表示できる数
+		static constexpr size_t Capacity = 32;
 
-		String viewText;
+	private:
+		struct View {
+			Vec2 pos;
+			JudgeType type = JudgeType::None;
+			double startTime = 0.0;
+		};
 
-		Color color;
+		std::array<View, Capacity> m_views;
+		size_t m_next = 0;
 
-		explicit JudgeView(int32 lane, const JudgeType& type) {
-			pos = { Globals::laneStartX + (Globals::laneWidth * lane + Globals::laneWidth / 2), Globals::judgeLineY - Globals::JudgeViewOffsets[Globals::judgeViewIndex] };
-			viewText = Globals::judgeName.at(type);
-			color = Globals::judgeColor.at(type);
+		// JudgeType の順の判定名(毎回文字列を作らない)
+		Array<DrawableText> m_texts;
+
+	public:
+		JudgeView() {
+			for (const JudgeType type : { JudgeType::Perfect, JudgeType::Great, JudgeType::Near, JudgeType::Miss }) {
+				m_texts << FontAsset(U"Font.Game.Judge.1")(Globals::judgeName.at(type));
+			}
+		}
+
+		/// @param x 表示するレーンの中心
+		void add(double x, JudgeType type) {
+			View& view = m_views[m_next];
+
+			view.pos = { x, Globals::judgeLineY - Globals::JudgeViewOffsets[Globals::judgeViewIndex] };
+			view.type = type;
+			view.startTime = Scene::Time();
+
+			m_next = (m_next + 1) % Capacity;
 		}
 
-		bool update(double t) override {
-			const double progress = EaseOutExpo(t / MaxLifetime);
+		void draw() const {
+			const double now = Scene::Time();
+
+			for (const auto& view : m_views) {
+				if (view.type == JudgeType::None) continue;
+
+				const double t = now - view.startTime;
+
+				if (MaxLifetime <= t) continue;
+
+				const double progress = EaseOutExpo(t / MaxLifetime);
 
-			fadeTransition.update(t <= MaxLifetime - FadeTime);
+				// 最初と最後の FadeTime でフェード
+				const double fade = Saturate(Min(t, MaxLifetime - t) / FadeTime);
 
-			const int32 alpha = static_cast<int32>(255 * fadeTransition.easeIn());
+				const int32 alpha = static_cast<int32>(255 * EaseInQuad(fade));
 
-			FontAsset(U"Font.Game.Judge.1")(viewText)
-				.drawAt(
-					TextStyle::Outline(0.1, Palette::White),
-					pos.movedBy(0, -FloatHeight * progress),
-					color.withAlpha(alpha)
-				);
-			return (t < MaxLifetime);
+				m_texts[static_cast<size_t>(view.type)]
+					.drawAt(
+						TextStyle::Outline(0.1, Palette::White),
+						view.pos.movedBy(0, -FloatHeight * progress),
+						Globals::judgeColor.at(view.type).withAlpha(alpha)
+					);
+			}
 		}
 	};
 }
@@ -1,10 +1,10 @@
 ﻿#pragma once
-#include <memory>
-#include <bitset>
-
 #include "Note.hpp"
-#include "LaneType.hpp"
+#include "LaneEngine.hpp"
 #include "Beatmap.hpp"
+#include "BeatmapWatcher.hpp"
+#include "InputSampler.hpp"
+#include "NumberText.hpp"
 #include "Effect/JudgeView.hpp"
 
 class GameManager {
@@ -18,122 +18,316 @@ class GameManager {
 
 	double scroll = 1.0;
 
+	/// @brief 画面に入る何秒前にノーツを有効にするか
+	static constexpr double SpawnMarginSec = 0.5;
+
+	/// @brief 判定を進める刻み(マイクロ秒, 1kHz)
+	/// @remark 描画のフレームとは別に、この刻みごとに時間順で判定する
+	static constexpr int64 StepMicros = 1'000;
+
+	/// @brief 1回の update で進める刻みの上限(止まっていたときに一度に刻みすぎないように)
+	static constexpr int64 MaxStepsPerUpdate = 250;
+
+	/// @brief 判定を進めた譜面上の時間
+	Optional<int64> m_simTime;
+
+	/// @brief records() のうち、まだ有効にしていない先頭のノーツ
+	/// @remark これより前は有効(判定・描画の対象)か判定済み、後ろはまだ触らない
+	size_t m_spawnIndex = 0;
+
+	/// @brief 有効なノーツ(譜面のレーン数に合わせた LaneEngine)
+	LaneEngineVariant m_engine;
+
+	/// @brief 描画するレーン数と左端(m_engine のもの)
+	int32 m_laneNum = Globals::defaultLaneNum;
+	double m_laneStartX = Globals::GetLaneStartX(Globals::defaultLaneNum);
+
+	/// @brief キーの変化を記録する入力スレッド(Globals::Settings::useInputThread のときだけ)
+	std::unique_ptr<InputSampler> m_inputSampler;
+
 	size_t m_maxCombo = 0;
 	size_t m_combo = 0;
 
+	/// @brief プレイ中の判定幅(途中で設定を変えても変わらない)
+	JudgeMode m_judgeMode = Globals::Settings::judgeMode;
+
+	/// @brief 音と表示の遅れ(マイクロ秒, 正なら遅れている)
+	/// @remark 判定は曲の時間から音の遅れを引いた譜面上の時間で行い、描画はそこから表示の遅れの分だけ先を描く
+	int64 m_audioOffset = Timeline::FromSec(Globals::Settings::audioOffset / 1000.0);
+	int64 m_visualOffset = Timeline::FromSec(Globals::Settings::visualOffset / 1000.0);
+
 	Audio m_noteClickSound = AudioAsset(U"Audio.Game.NoteClick");
 
-	Effect m_judgeViewer;
+	MyEffect::JudgeView m_judgeViewer;
 
-public:
-	GameManager() = default;
+	// 描画のたびに文字列を作らないよう、プレイ中に使う文字はあらかじめ作っておく
+	NumberText m_comboText{ FontAsset(U"Font.Game.Combo") };
+	Array<DrawableText> m_keyLabels;
 
-	GameManager(const Beatmap& beatmap) : m_beatmap{ beatmap } {
+	void makeKeyLabels() {
+		m_keyLabels.clear();
 
+		std::visit([&](const auto& engine) {
+			for (const InputGroup& key : engine.keys()) {
+				m_keyLabels << FontAsset(U"Font.UI.Detail")(key.inputs().front().name());
+			}
+		}, m_engine);
 	}
 
-	void update(double t, bool autoMode = false) {
-		std::bitset<4> processedLane = 0b0000;
+	/// @brief ノーツをレーンの末尾に追加する
+	void activate(const BeatmapBinary::NoteRecord& record) {
+		std::visit([&](auto& engine) { engine.activate(record, m_beatmap.offset); }, m_engine);
+	}
 
-		for (auto&& note : m_beatmap.notes) {
-			JudgeType judge = note->update(t);
+	/// @brief 判定を集計する
+	/// @param captured 判定のきっかけのキーの変化を記録した時刻(遅れの計測に使う), キーによらなければ0
+	void addJudge(const NoteStore& notes, size_t i, JudgeType judge, uint64 captured) {
+		LatencyMonitor& latency = Globals::latencyMonitor;
 
-			HoldNote* holdNote = dynamic_cast<HoldNote*>(note.get());
+		latency.record(LatencyMonitor::Stage::Judge, captured);
 
-			if (autoMode) {
-				judge = JudgeType::None;
-				if (note->timeDiff(t) <= 0) {
-					judge = JudgeType::Perfect;
-					note->isRemovable = true;
+		if (judge != JudgeType::Miss) {
+			m_noteClickSound.playOneShot(Globals::Settings::effectVolume);
 
-					if (holdNote != nullptr) {
-						if (holdNote->isHolding && 0 < note->timeDiff(t - holdNote->length)) {
-							judge = JudgeType::None;
-							note->isRemovable = false;
-						}
+			latency.record(LatencyMonitor::Stage::Sound, captured);
 
-						if (not holdNote->isHolding) {
-							note->isRemovable = false;
-							holdNote->isHolding = true;
-						}
-					}
-				}
+			m_combo += 1;
+			if (m_maxCombo < m_combo) m_maxCombo = m_combo;
+		}
+		else {
+			m_combo = 0;
+
+			// not isHoldingのときは終点も考慮してmissを++する
+			if (notes.type[i] == NoteType::Hold) {
+				if (not notes.isHolding(i)) m_judges[judge] += 1;
 			}
+		}
 
-			if (judge == JudgeType::None) continue;
-			if (processedLane[note->lane] & 1) continue;
+		m_judgeViewer.add(m_laneStartX + (Globals::laneWidth * notes.lane[i] + Globals::laneWidth / 2), judge);
 
-			int8 state = 1;
+		latency.recordEffect(captured);
 
-			if (holdNote != nullptr) {
-				if (holdNote->isHolding) state = 0;
-			}
+		m_judges[judge] += 1;
+	}
+
+public:
+	GameManager() {
+		makeKeyLabels();
+	}
+
+	/// @remark 譜面のレーン数に対応していなければ例外を投げる
+	GameManager(const Beatmap& beatmap)
+		: m_beatmap{ beatmap }
+		, m_engine{ MakeLaneEngine(beatmap.laneCount) } {
+		std::visit([&](auto& engine) {
+			using Engine = std::remove_cvref_t<decltype(engine)>;
 
-			if (judge != JudgeType::Miss) {
-				m_noteClickSound.playOneShot(Globals::Settings::effectVolume);
+			m_laneNum = Engine::LaneNum;
+			m_laneStartX = Engine::StartX;
 
-				m_combo += 1;
-				if (m_maxCombo < m_combo) m_maxCombo = m_combo;
+			// プレイ中に配列が伸びないよう、レーンごとのノーツ数だけ先に確保しておく
+			std::array<size_t, Engine::LaneNum> noteCounts{};
+
+			for (const auto& record : m_beatmap.records()) {
+				if (record.lane < noteCounts.size()) ++noteCounts[record.lane];
+			}
+
+			for (size_t lane = 0; lane < noteCounts.size(); ++lane) {
+				engine.reserve(lane, noteCounts[lane]);
 			}
-			if(judge == JudgeType::Miss) {
-				note->isRemovable = true;
+		}, m_engine);
 
-				m_combo = 0;
+		makeKeyLabels();
 
-				// not isHoldingのときは終点も考慮してmissを++する
-				if (holdNote != nullptr) {
-					if (not holdNote->isHolding) m_judges[judge] += 1;
-				}
+		if (Globals::Settings::useInputThread) {
+			m_inputSampler = std::make_unique<InputSampler>(std::visit([](const auto& engine) { return engine.keys(); }, m_engine));
+		}
+
+		spawnNotes(0);
+	}
+
+	/// @brief ノーツが有効になってから判定ラインに届くまでの時間(マイクロ秒)
+	/// @remark 画面に入る少し前か、最も広い判定幅に入ったときのうち早い方
+	int64 getLookahead() const {
+		// 判定ラインから画面上端まで流れるのにかかる時間
+		const double visible = Globals::judgeLineY / (Globals::defaultNoteSpeed * Globals::speed * scroll) + SpawnMarginSec;
+
+		return Max(Timeline::FromSec(visible), getMissTiming());
+	}
+
+	/// @brief 判定ラインを過ぎてから Miss になるまでの時間(マイクロ秒)
+	int64 getMissTiming() const {
+		return VisitJudgeWindow(m_judgeMode, [](auto window) { return decltype(window)::NearUs; });
+	}
+
+	/// @brief 判定・描画の対象に入ったノーツを有効にする
+	/// @param t 現在時間(マイクロ秒)
+	/// @remark 1フレームのコストが譜面全体ではなく有効なノーツの数で決まるよう、
+	/// records() の時間順に先頭から必要な分だけレーンに移す
+	void spawnNotes(int64 t) {
+		const auto records = m_beatmap.records();
+
+		const int64 lookahead = getLookahead();
+
+		while (m_spawnIndex < records.size()) {
+			const auto& record = records[m_spawnIndex];
+
+			if (t + lookahead < m_beatmap.offset + record.timing) break;
+
+			activate(record);
+
+			++m_spawnIndex;
+		}
+	}
+
+	/// @brief 譜面の変更を再生中のノーツに反映する
+	/// @param patch BeatmapWatcher で得た差分
+	/// @param t 現在時間(マイクロ秒)
+	/// @remark 判定ラインを過ぎたノーツは追加しない。メモリマップ譜面には使えない
+	/// レーン数は読み込み時のまま変えない(レーン数が変わった差分は当てない)
+	void applyPatch(const BeatmapPatch& patch, int64 t) {
+		assert(not m_beatmap.isMapped());
+
+		if (patch.header.laneCount != static_cast<uint32>(m_laneNum)) {
+			Logger << U"Beatmap patch ignored: lane count changed from {} to {}"_fmt(m_laneNum, patch.header.laneCount);
+			return;
+		}
+
+		t -= m_audioOffset;
+
+		// まだ有効にしていないノーツ
+		auto& pending = m_beatmap.chartRecords;
+
+		for (const auto& record : patch.removed) {
+			std::visit([&](auto& engine) { engine.remove(record, patch.oldOffset); }, m_engine);
+
+			if (auto it = std::find(pending.begin() + m_spawnIndex, pending.end(), record); it != pending.end()) {
+				pending.erase(it);
 			}
+		}
+
+		m_beatmap.bpm = patch.header.bpm;
+		m_beatmap.offset = patch.newOffset;
+		m_beatmap.maxCombo = static_cast<size_t>(patch.header.maxCombo);
 
-			m_judgeViewer.add<MyEffect::JudgeView>(note->lane, judge);
+		const int64 missTiming = getMissTiming();
+		const int64 lookahead = getLookahead();
+
+		for (const auto& record : patch.added) {
+			const int64 timing = patch.newOffset + record.timing;
+
+			if (timing + record.length + missTiming < t) continue;
+
+			if (timing <= t + lookahead) {
+				activate(record);
+				continue;
+			}
 
-			m_judges[judge] += 1;
+			const auto it = std::upper_bound(pending.begin() + m_spawnIndex, pending.end(), record,
+				[](const auto& a, const auto& b) { return a.timing < b.timing; });
 
-			processedLane[note->lane] = state;
+			pending.insert(it, record);
 		}
 
-		m_beatmap.notes.remove_if([=](const auto& note) {
-			return note->isRemovable;
+		std::visit([](auto& engine) { engine.sortByTiming(); }, m_engine);
+	}
+
+	/// @param t 現在時間(マイクロ秒)
+	/// @param clock t を求めた時刻(Time::GetMicrosec), 入力スレッドのキーの変化を譜面上の時間に直すのに使う
+	/// @param autoMode オートプレイ
+	/// @remark 前回から t までを StepMicros ごとに刻んで判定する。描画のフレームが長くても、
+	/// 判定とコンボはキーの変化やノーツの時間の順に(刻みの精度で)進む
+	void update(int64 t, uint64 clock, bool autoMode = false) {
+		t -= m_audioOffset;
+
+		spawnNotes(t);
+
+		// 刻みの格子は最初の update の時間に合わせる。止まっていたときは最後の MaxStepsPerUpdate 回分だけ刻む
+		// (飛ばした間のキーの変化も、次の刻みでそれぞれの時間で判定する)
+		const int64 begin = Max(m_simTime.value_or(t - StepMicros), t - StepMicros * MaxStepsPerUpdate);
+		const int64 steps = Max<int64>((t - begin) / StepMicros, 0);
+		const int64 end = begin + steps * StepMicros;
+
+		// 前のフレームからのキーの変化を、譜面上の時間に直して集める
+		std::visit([&](auto& engine) {
+			if (not m_inputSampler) {
+				// フレームで読んだ変化は、このフレームの最後の刻みで判定する
+				engine.pollKeys(end, clock);
+				return;
+			}
+
+			m_inputSampler->drain([&](const KeyEvent& event) {
+				// clock より後に記録された変化はこのフレームの時間で扱う
+				const int64 age = static_cast<int64>(clock - Min(event.time, clock));
+
+				engine.addKeyEvent(event.lane, LaneEvent{ t - age, event.pressed, event.time });
+
+				Globals::latencyMonitor.record(LatencyMonitor::Stage::Pickup, event.time, clock);
+			});
+		}, m_engine);
+
+		// 判定幅とレーン数の組み合わせごとに展開された判定ループを呼ぶ
+		VisitJudgeWindow(m_judgeMode, [&](auto window) {
+			std::visit([&](auto& engine) {
+				for (int64 step = 1; step <= steps; ++step) {
+					engine.template update<decltype(window)>(begin + step * StepMicros, autoMode, [&](const NoteStore& notes, size_t i, JudgeType judge, uint64 captured) {
+						addJudge(notes, i, judge, captured);
+					});
+				}
+			}, m_engine);
 		});
+
+		m_simTime = Max(end, m_simTime.value_or(end));
 	}
 
-	void draw(double t) const {
+	/// @brief 判定を進めた譜面上の時間(マイクロ秒)
+	/// @remark update に渡した時間より最大 StepMicros だけ前
+	Optional<int64> getSimulatedTime() const {
+		return m_simTime;
+	}
+
+	/// @param t 現在時間(マイクロ秒)
+	/// @remark ノーツの位置は判定の刻みではなく描画する時点の t から求める(刻みの間を補間する)。
+	/// どのノーツが残っているかは最後に判定した刻みのもの
+	void draw(int64 t) const {
+		t += m_visualOffset - m_audioOffset;
+
 		// レーン
 		drawLane();
 
 		// note
-		for (const auto& note : m_beatmap.notes) {
-			note->draw(t, scroll);
-		}
+		std::visit([&](const auto& engine) { engine.draw(t, scroll); }, m_engine);
 
 		// measure line
 		drawMeasureLines(t);
 
 		// combo
 		{
-			double x = Globals::laneStartX + (Globals::laneWidth * (Globals::laneNum / 2));
+			double x = m_laneStartX + (Globals::laneWidth * (m_laneNum / 2));
 
-			FontAsset(U"Font.Game.Combo")((m_combo < 10) ? U"" : U"{}"_fmt(m_combo)).drawAt(TextStyle::Outline(0.2, Palette::Black), x, Globals::judgeLineY - 300);
+			if (10 <= m_combo) {
+				m_comboText.drawAt(TextStyle::Outline(0.2, Palette::Black), m_combo, Vec2{ x, Globals::judgeLineY - 300 });
+			}
 		}
 
 		drawJudgeLine();
 
-		m_judgeViewer.update();
+		m_judgeViewer.draw();
 	}
 
 	void drawLane() const {
-		for (int32 i : step(Globals::laneNum)) {
-			double x = Globals::laneStartX + (Globals::laneWidth * i);
+		const std::span<const InputGroup> keys = std::visit([](const auto& engine) { return engine.keys(); }, m_engine);
+
+		for (int32 i : step(m_laneNum)) {
+			double x = m_laneStartX + (Globals::laneWidth * i);
 
 			// lane
 			RectF rect{ x, .0, Globals::laneWidth, Globals::windowSize.y };
 			rect.draw(Palette::Black).drawFrame(1.0, Palette::White);
 
-			const InputGroup& key = Globals::controllKeys[static_cast<LaneType>(i)];
+			const InputGroup& key = keys[i];
 
-			FontAsset(U"Font.UI.Detail")(key.inputs().front().name())
-				.draw(Arg::topCenter = Vec2{ rect.centerX(), Globals::judgeLineY + 60.0 }, Palette::White);
+			m_keyLabels[i].draw(Arg::topCenter = Vec2{ rect.centerX(), Globals::judgeLineY + 60.0 }, Palette::White);
 
 			// key beam
 			if (key.pressed()) {
@@ -143,26 +337,28 @@ public:
 		}
 	}
 
-	void drawMeasureLines(double t) const {
+	void drawMeasureLines(int64 time) const {
+		// 小節線は描画だけなので秒で計算する
+		const double t = Timeline::ToSec(time);
+		const double offset = Timeline::ToSec(m_beatmap.offset);
+
 		// 1小節の時間
 		double measureDuration = 4.0 * (60.0 / m_beatmap.bpm);
 
-		int32 startMeasure = static_cast<int32>(
-			(t - (m_beatmap.offset / 1000))
-			/ measureDuration
-		);
+		// 判定ラインにいる小節から描く(offset は秒に直してある)
+		int32 startMeasure = static_cast<int32>(Math::Floor((t - offset) / measureDuration));
 
 		int32 i = startMeasure;
 		double y = 0.0;
 
 		do {
-			double measureTime = i * measureDuration + m_beatmap.offset;
+			double measureTime = i * measureDuration + offset;
 
 			y = Globals::judgeLineY - ((measureTime - t) * Globals::defaultNoteSpeed) * (Globals::speed * scroll);
 
 			Line{
-				Globals::laneStartX, y,
-				Globals::laneStartX + Globals::laneWidth * Globals::laneNum, y
+				m_laneStartX, y,
+				m_laneStartX + Globals::laneWidth * m_laneNum, y
 			}.draw(1.0, Palette::White);
 
 			i++;
@@ -171,8 +367,8 @@ public:
 
 	void drawJudgeLine() const {
 		Line judgeLine{
-			Globals::laneStartX, Globals::judgeLineY,
-			Globals::laneStartX + Globals::laneWidth * Globals::laneNum, Globals::judgeLineY
+			m_laneStartX, Globals::judgeLineY,
+			m_laneStartX + Globals::laneWidth * m_laneNum, Globals::judgeLineY
 		};
 
 		judgeLine.draw(2.0, Palette::Orange);
@@ -182,8 +378,12 @@ public:
 		return m_judges;
 	}
 
-	inline const Array<std::shared_ptr<Note>>& getNote() const noexcept {
-		return m_beatmap.notes;
+	inline std::span<const NoteStore> getNote() const noexcept {
+		return std::visit([](const auto& engine) { return engine.lanes(); }, m_engine);
+	}
+
+	inline int32 getLaneNum() const noexcept {
+		return m_laneNum;
 	}
 
 	inline const Beatmap& getBeatmap() const noexcept {
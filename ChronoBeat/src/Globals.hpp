@@ -1,9 +1,11 @@
 ﻿#pragma once
 #include "SemVer.hpp"
-#include "LaneType.hpp"
 #include "JudgeType.hpp"
+#include "JudgeWindow.hpp"
 #include "SongInfo.hpp"
+#include "SongLibrary.hpp"
 #include "Config.hpp"
+#include "LatencyMonitor.hpp"
 
 #include "LeaderBoard.hpp"
 
@@ -14,8 +16,19 @@ namespace Globals {
 
 	inline constexpr Size windowSize{ 1920, 1080 };
 
+	inline SongLibrary songLibrary;
+
 	inline Array<SongInfo> songInfos;
 
+	// songInfos がすべて揃ったか(起動時に裏で読み込んでいる)
+	inline bool isSongLibraryLoaded = false;
+
+	// 譜面制作用: プレイ中に譜面の保存を検知して反映する (--hot-reload)
+	inline bool isHotReloadEnabled = false;
+
+	// 入力から音・画面までの遅れの計測 (--latency のときだけ有効)
+	inline LatencyMonitor latencyMonitor;
+
 	// Volume
 	namespace Settings {
 		inline double masterVolume = Config.getValue<double>(U"Volume.master", 0.5);
@@ -25,6 +38,16 @@ namespace Globals {
 
 		inline String username = Config.getValue<String>(U"Profile.username", U"Guest{:0>4d}"_fmt(Random<int32>(9999)));
 
+		// 判定幅 (normal / strict)
+		inline JudgeMode judgeMode = ParseJudgeMode(Config.getValue<String>(U"Game.judge", U"normal"));
+
+		// 入力を別スレッドで読んで、キーの変化を時刻付きで記録する
+		inline bool useInputThread = Config.getValue<bool>(U"Game.input_thread", true);
+
+		// 音と表示の遅れ(ms, CalibrationScene で測る)
+		inline double audioOffset = Config.getValue<double>(U"Game.audio_offset", 0.0);
+		inline double visualOffset = Config.getValue<double>(U"Game.visual_offset", 0.0);
+
 		inline void reload() {
 			masterVolume = Config.getValue<double>(U"Volume.master", 0.5);
 			songVolume = Config.getValue<double>(U"Volume.song", 1.0);
@@ -33,17 +56,39 @@ namespace Globals {
 
 			username = Config.getValue<String>(U"Profile.username", U"Guest{:0>4d}"_fmt(Random<int32>(9999)));
 
+			judgeMode = ParseJudgeMode(Config.getValue<String>(U"Game.judge", U"normal"));
+			useInputThread = Config.getValue<bool>(U"Game.input_thread", true);
+
+			audioOffset = Config.getValue<double>(U"Game.audio_offset", 0.0);
+			visualOffset = Config.getValue<double>(U"Game.visual_offset", 0.0);
+
 			GlobalAudio::SetVolume(masterVolume);
 		}
 	}
 
 	// lane
-	inline const int32 laneNum = 4;
-	inline const int32 laneWidth = 128;
+	// 譜面の "lanes" で指定できるレーン数
+	inline constexpr std::array<int32, 4> laneCounts = { 4, 6, 7, 8 };
+	inline constexpr int32 defaultLaneNum = 4;
 
-	inline const double laneStartX =
-		(windowSize.x / 2 - laneWidth / 2 - (laneWidth * (laneNum / 2)))
-		- 300;
+	inline constexpr int32 laneWidth = 128;
+
+	/// @brief レーンの左端
+	/// @param laneNum レーン数
+	constexpr double GetLaneStartX(int32 laneNum) {
+		return (windowSize.x / 2 - laneWidth / 2 - (laneWidth * (laneNum / 2)))
+			- 300;
+	}
+
+	/// @brief 対応しているレーン数か
+	/// @param lanes 譜面のレーン数
+	constexpr bool IsSupportedLaneCount(int64 lanes) {
+		for (const int32 count : laneCounts) {
+			if (lanes == count) return true;
+		}
+
+		return false;
+	}
 
 	inline const int32 judgeLineY = windowSize.y - 120;
 
@@ -83,6 +128,7 @@ namespace Globals {
 	}
 
 	inline const FilePath BeatmapBaseDir = U"beatmap";
+	inline const FilePath SongLibraryIndexPath = U"songlibrary.idx";
 
 	inline std::array<double, 3> JudgeViewOffsets = {
 		100,
@@ -91,18 +137,12 @@ namespace Globals {
 	};
 	inline size_t judgeViewIndex = Clamp<size_t>(Config.getValue(U"judge_view", 1), 0, JudgeViewOffsets.size());
 
-	// key
-	inline HashTable<LaneType, InputGroup> controllKeys = {
-		{ LaneType::D, KeyD },
-		{ LaneType::F, KeyF },
-		{ LaneType::J, KeyJ },
-		{ LaneType::K, KeyK }
-	};
-
-	inline HashTable<JudgeType, int32> judgeTimings = {
-		{ JudgeType::Perfect, 40 },
-		{ JudgeType::Great, 60 },
-		{ JudgeType::Near, 80 }
+	// key (レーン数ごと, 左のレーンから順)
+	inline HashTable<int32, Array<InputGroup>> laneKeys = {
+		{ 4, { KeyD, KeyF, KeyJ, KeyK } },
+		{ 6, { KeyS, KeyD, KeyF, KeyJ, KeyK, KeyL } },
+		{ 7, { KeyS, KeyD, KeyF, KeySpace, KeyJ, KeyK, KeyL } },
+		{ 8, { KeyA, KeyS, KeyD, KeyF, KeyJ, KeyK, KeyL, KeySemicolon_JIS } }
 	};
 
 	inline HashTable<JudgeType, double> judgeScoreRatio = {
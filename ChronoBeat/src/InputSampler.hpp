@@ -0,0 +1,140 @@
+﻿#pragma once
+#include <Siv3D.hpp>
+#include <Siv3D/Windows/Windows.hpp>
+#include <thread>
+
+#include "LaneInput.hpp"
+#include "SpscRing.hpp"
+
+/// @brief 描画とは別のスレッドでキーボードを読み、キーの変化を時刻付きで記録する
+/// @remark フレームごとに InputGroup を読むと判定の精度がフレーム間隔(60Hz で ±8ms)に丸められるため、
+/// 短い間隔で GetAsyncKeyState を読んで、変化した時刻を残す。キーボード以外の入力は扱わない
+class InputSampler {
+public:
+	/// @brief 読み出されずに溜められるキーの変化の数
+	static constexpr size_t Capacity = 1024;
+
+	/// @brief キーを読む間隔
+	static constexpr Microseconds PollInterval{ 250 };
+
+private:
+	// レーンごとの仮想キーコード
+	Array<Array<int32>> m_virtualKeys;
+
+	HWND m_hwnd = nullptr;
+
+	SpscRing<KeyEvent, Capacity> m_events;
+
+	// いっぱいで捨てた数
+	std::atomic<uint64> m_dropped = 0;
+
+	// 最後に宣言して、最初に止める
+	std::jthread m_thread;
+
+	bool isFocused() const {
+		return ::GetForegroundWindow() == m_hwnd;
+	}
+
+	bool isPressed(size_t lane) const {
+		for (const int32 virtualKey : m_virtualKeys[lane]) {
+			if (::GetAsyncKeyState(virtualKey) & 0x8000) return true;
+		}
+
+		return false;
+	}
+
+	/// @brief PollInterval だけ待つ
+	/// @param timer 高精度タイマー, 作れなかった場合は nullptr
+	static void Wait(HANDLE timer) {
+		if (timer) {
+			// 100ns 単位、負の値で相対時間
+			LARGE_INTEGER dueTime;
+			dueTime.QuadPart = -(PollInterval.count() * 10);
+
+			if (::SetWaitableTimer(timer, &dueTime, 0, nullptr, nullptr, FALSE)) {
+				::WaitForSingleObject(timer, INFINITE);
+				return;
+			}
+		}
+
+		::Sleep(1);
+	}
+
+	void run(std::stop_token stopToken) {
+		// 1ms より細かく待てるタイマー (Windows 10 1803 以降)
+		HANDLE timer = ::CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+
+		if (not timer) {
+			Logger << U"InputSampler: high resolution timer is not available, polling every 1ms";
+		}
+
+		// 始めから押されているキーは変化として記録しない
+		Array<bool> states(m_virtualKeys.size(), false);
+
+		for (size_t lane = 0; lane < states.size(); ++lane) {
+			states[lane] = isFocused() && isPressed(lane);
+		}
+
+		while (not stopToken.stop_requested()) {
+			const bool focused = isFocused();
+			const uint64 time = Time::GetMicrosec();
+
+			for (size_t lane = 0; lane < states.size(); ++lane) {
+				// ウィンドウが非アクティブになったら離したことにする
+				const bool pressed = focused && isPressed(lane);
+
+				if (pressed == states[lane]) continue;
+
+				states[lane] = pressed;
+
+				if (not m_events.push(KeyEvent{ time, static_cast<uint8>(lane), pressed })) {
+					m_dropped.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+
+			Wait(timer);
+		}
+
+		if (timer) ::CloseHandle(timer);
+	}
+
+public:
+	/// @param keys レーンごとのキー(左のレーンから順)
+	explicit InputSampler(std::span<const InputGroup> keys)
+		: m_hwnd{ static_cast<HWND>(Platform::Windows::Window::GetHWND()) } {
+		for (const InputGroup& key : keys) {
+			Array<int32> virtualKeys;
+
+			for (const Input& input : key.inputs()) {
+				if (input.deviceType() == InputDeviceType::Keyboard) virtualKeys << input.code();
+			}
+
+			m_virtualKeys << std::move(virtualKeys);
+		}
+
+		m_thread = std::jthread{ [this](std::stop_token stopToken) { run(stopToken); } };
+	}
+
+	InputSampler(const InputSampler&) = delete;
+	InputSampler& operator=(const InputSampler&) = delete;
+
+	/// @brief 記録したキーの変化を古い順に f に渡す
+	/// @return 渡した数
+	template <class F>
+	size_t drain(F&& f) {
+		size_t count = 0;
+		KeyEvent event;
+
+		while (m_events.pop(event)) {
+			f(event);
+			++count;
+		}
+
+		return count;
+	}
+
+	/// @brief バッファがいっぱいで捨てたキーの変化の数
+	uint64 getDroppedCount() const noexcept {
+		return m_dropped.load(std::memory_order_relaxed);
+	}
+};
@@ -0,0 +1,139 @@
+﻿#pragma once
+#include <Siv3D.hpp>
+
+/// @brief ジャケットを縮小して1枚のテクスチャにまとめるアトラス
+/// @remark 読み込みは request() されたものだけ裏で行い、枠が足りなければ最も長く使っていないものを追い出す
+class JacketAtlas {
+	struct Slot {
+		Optional<size_t> id;
+		uint64 lastUsed = 0;
+	};
+
+	Size m_cellSize;
+	Point m_grid;
+
+	Image m_image;
+	DynamicTexture m_texture;
+	bool m_dirty = false;
+
+	Array<Slot> m_slots;
+
+	// id -> m_slots のインデックス
+	HashTable<size_t, size_t> m_slotIndices;
+
+	HashTable<size_t, AsyncTask<Image>> m_loading;
+
+	uint64 m_frame = 1;
+
+	/// @brief 比率を維持して cellSize を覆うように縮小し、はみ出た分を切り取る
+	static Image Decode(const FilePath& path, const Size& cellSize) {
+		const Image image{ Resource(path) };
+
+		if (not image) return Image{ cellSize, Palette::Black };
+
+		const double scale = Max(
+			static_cast<double>(cellSize.x) / image.width(),
+			static_cast<double>(cellSize.y) / image.height()
+		);
+
+		const Image scaled = image.resized(Size{
+			Max(cellSize.x, static_cast<int32>(Math::Ceil(image.width() * scale))),
+			Max(cellSize.y, static_cast<int32>(Math::Ceil(image.height() * scale)))
+		});
+
+		return scaled.clipped(Rect{ Arg::center = scaled.size() / 2, cellSize });
+	}
+
+	Point getCellPos(size_t slot) const {
+		return Point{ static_cast<int32>(slot % m_grid.x) * m_cellSize.x, static_cast<int32>(slot / m_grid.x) * m_cellSize.y };
+	}
+
+	/// @brief 空いている枠か、今フレームで使われていない中で最も古い枠
+	Optional<size_t> findSlot() const {
+		Optional<size_t> result;
+
+		for (auto&& [i, slot] : Indexed(m_slots)) {
+			if (not slot.id) return i;
+			if (m_frame <= slot.lastUsed) continue;
+
+			if (not result || slot.lastUsed < m_slots[*result].lastUsed) result = i;
+		}
+
+		return result;
+	}
+
+public:
+	JacketAtlas() = default;
+
+	/// @param cellSize 1枚あたりの大きさ
+	/// @param atlasSize アトラスの大きさ
+	JacketAtlas(const Size& cellSize, const Size& atlasSize = { 2048, 2048 }) :
+		m_cellSize{ cellSize },
+		m_grid{ atlasSize.x / cellSize.x, atlasSize.y / cellSize.y },
+		m_image{ atlasSize, Palette::Black },
+		m_texture{ m_image },
+		m_slots(m_grid.x * m_grid.y) { }
+
+	/// @brief ジャケットを使うことを伝える(毎フレーム呼ぶ)
+	/// @param id 曲のインデックス
+	/// @param path ジャケットのパス
+	void request(size_t id, const FilePath& path) {
+		if (auto it = m_slotIndices.find(id); it != m_slotIndices.end()) {
+			m_slots[it->second].lastUsed = m_frame;
+			return;
+		}
+
+		if (m_loading.contains(id)) return;
+
+		m_loading.emplace(id, Async(Decode, path, m_cellSize));
+	}
+
+	/// @brief 読み込み終わったジャケットをアトラスに書き込む(毎フレーム request() の後に呼ぶ)
+	void update() {
+		for (auto it = m_loading.begin(); it != m_loading.end();) {
+			if (not it->second.isReady()) {
+				++it;
+				continue;
+			}
+
+			const size_t id = it->first;
+			const Image image = it->second.get();
+
+			it = m_loading.erase(it);
+
+			// 全部の枠が使用中なら捨てて、次に request() されたときに読み直す
+			const Optional<size_t> slot = findSlot();
+
+			if (not slot) continue;
+
+			if (const auto& old = m_slots[*slot].id) {
+				m_slotIndices.erase(*old);
+			}
+
+			image.overwrite(m_image, getCellPos(*slot));
+
+			m_slots[*slot] = Slot{ id, m_frame };
+			m_slotIndices[id] = *slot;
+
+			m_dirty = true;
+		}
+
+		// 1フレームに何枚読み込まれても転送は1回
+		if (m_dirty) {
+			m_texture.fill(m_image);
+			m_dirty = false;
+		}
+
+		++m_frame;
+	}
+
+	/// @brief アトラス上のジャケット
+	/// @return まだ読み込まれていなければnone
+	Optional<TextureRegion> get(size_t id) const {
+		if (auto it = m_slotIndices.find(id); it != m_slotIndices.end()) {
+			return m_texture(Rect{ getCellPos(it->second), m_cellSize });
+		}
+
+		return none;
+	}
+};
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include "JudgeType.hpp"
+#include "Timeline.hpp"
+
+/// @brief 判定幅のプリセット
+/// @remark Windows は JudgeType の順 (Perfect, Great, Near) の ms で、狭い順に並んでいること
+namespace JudgePreset {
+	struct Normal {
+		static constexpr std::array<int32, 3> Windows{ 40, 60, 80 };
+	};
+
+	struct Strict {
+		static constexpr std::array<int32, 3> Windows{ 25, 40, 60 };
+	};
+}
+
+/// @brief 判定幅の選び方 (config.ini の Game.judge)
+enum class JudgeMode : int32 {
+	Normal,
+	Strict
+};
+
+inline JudgeMode ParseJudgeMode(StringView name) {
+	if (name == U"strict") return JudgeMode::Strict;
+
+	return JudgeMode::Normal;
+}
+
+/// @brief プリセットの判定幅をマイクロ秒にした表と、時間差からの判定
+/// @tparam Preset JudgePreset のいずれか
+template <class Preset>
+struct JudgeWindow {
+	static constexpr auto& Windows = Preset::Windows;
+
+	static_assert(Windows[0] < Windows[1] && Windows[1] < Windows[2], "judge windows must be sorted");
+
+	static constexpr int64 PerfectUs = Timeline::FromMillis(Windows[static_cast<size_t>(JudgeType::Perfect)]);
+	static constexpr int64 GreatUs = Timeline::FromMillis(Windows[static_cast<size_t>(JudgeType::Great)]);
+	static constexpr int64 NearUs = Timeline::FromMillis(Windows[static_cast<size_t>(JudgeType::Near)]);
+
+	/// @brief ノーツのタイミングとの時間差から判定を得る
+	/// @param diff ノーツのタイミング - 現在時間(マイクロ秒)
+	/// @return 判定, 判定の範囲外ならNone
+	static constexpr JudgeType Classify(int64 diff) noexcept {
+		if (diff < -NearUs) return JudgeType::Miss;
+
+		const int64 adiff = (diff < 0) ? -diff : diff;
+
+		if (NearUs < adiff) return JudgeType::None;
+		if (GreatUs < adiff) return JudgeType::Near;
+		if (PerfectUs < adiff) return JudgeType::Great;
+
+		return JudgeType::Perfect;
+	}
+};
+
+/// @brief モードに対応するプリセットを渡して f を呼ぶ
+/// @param mode 判定幅のモード
+/// @param f JudgeWindow<Preset> を受け取る関数
+template <class F>
+decltype(auto) VisitJudgeWindow(JudgeMode mode, F&& f) {
+	switch (mode) {
+	case JudgeMode::Strict: return f(JudgeWindow<JudgePreset::Strict>{});
+	default: return f(JudgeWindow<JudgePreset::Normal>{});
+	}
+}
+
+static_assert(JudgeWindow<JudgePreset::Normal>::Classify(0) == JudgeType::Perfect);
+static_assert(JudgeWindow<JudgePreset::Normal>::Classify(40'000) == JudgeType::Perfect);
+static_assert(JudgeWindow<JudgePreset::Normal>::Classify(-50'000) == JudgeType::Great);
+static_assert(JudgeWindow<JudgePreset::Normal>::Classify(70'000) == JudgeType::Near);
+static_assert(JudgeWindow<JudgePreset::Normal>::Classify(100'000) == JudgeType::None);
+static_assert(JudgeWindow<JudgePreset::Normal>::Classify(-100'000) == JudgeType::Miss);
@@ -0,0 +1,283 @@
+﻿#pragma once
+#include "Note.hpp"
+#include "BeatmapBinary.hpp"
+#include "LaneInput.hpp"
+
+/// @brief レーン数を固定したノーツの判定と描画
+/// @tparam LaneCount レーン数 (Globals::laneCounts のいずれか)
+/// @remark レーンとキーを固定長の配列で持ち、レーンのループはコンパイル時に展開する
+template <size_t LaneCount>
+class LaneEngine {
+public:
+	static constexpr int32 LaneNum = static_cast<int32>(LaneCount);
+
+	/// @brief レーンの左端
+	static constexpr double StartX = Globals::GetLaneStartX(LaneNum);
+
+private:
+	/// @brief レーンごとの有効なノーツ(時間順)
+	/// @remark 入力は先頭のノーツにだけ渡すので、同じレーンで最も早いノーツが必ず判定される
+	std::array<NoteStore, LaneCount> m_lanes;
+
+	/// @brief レーンごとのキー(左のレーンから順)
+	std::array<InputGroup, LaneCount> m_keys;
+
+	/// @brief レーンごとのまだ判定していないキーの変化(古い順)
+	std::array<Array<LaneEvent>, LaneCount> m_events;
+
+	/// @brief レーンごとの判定した時間で押されていたか
+	std::array<bool, LaneCount> m_held{};
+
+	/// @brief 1レーンに溜めておくキーの変化の数(超えたら伸ばす)
+	static constexpr size_t EventReserve = 16;
+
+	/// @brief 描画用: 全レーンのノーツの始点・終点のY座標(レーン順に詰める)
+	mutable Array<double> m_headY;
+	mutable Array<double> m_tailY;
+
+	/// @brief 0 ~ LaneCount-1 のレーン番号を定数で渡して f を呼ぶ
+	template <class F>
+	static void ForEachLane(F&& f) {
+		[&]<size_t... Lane>(std::index_sequence<Lane...>) {
+			(f(std::integral_constant<size_t, Lane>{}), ...);
+		}(std::make_index_sequence<LaneCount>{});
+	}
+
+	/// @brief オートプレイでの判定
+	static JudgeType UpdateAuto(NoteStore& notes, size_t i, int64 t) {
+		const int64 timeDiff = notes.timing[i] - t;
+
+		if (0 < timeDiff) return JudgeType::None;
+
+		if (notes.type[i] == NoteType::Hold) {
+			if (not notes.isHolding(i)) {
+				notes.setHolding(i);
+				return JudgeType::Perfect;
+			}
+
+			if (0 < timeDiff + notes.length[i]) return JudgeType::None;
+		}
+
+		notes.setRemovable(i);
+
+		return JudgeType::Perfect;
+	}
+
+	/// @brief 判定済みでない先頭のノーツから順に judgeNote(head) で判定する
+	/// @param captured 判定のきっかけのキーの変化を記録した時刻, キーによらなければ0
+	/// @return 1つでも判定したか
+	/// @remark 入力を受け取るのは先頭のノーツだけ
+	/// 先頭が Miss になったときは、次のノーツも判定幅を過ぎていないか続けて見る
+	template <class JudgeNote, class OnJudge>
+	static bool JudgeHead(NoteStore& notes, uint64 captured, JudgeNote&& judgeNote, OnJudge&& onJudge) {
+		bool judged = false;
+
+		for (size_t head = 0; head < notes.size(); ++head) {
+			// 同じ刻みの前の入力で判定したノーツ
+			if (notes.isRemovable(head)) continue;
+
+			const JudgeType judge = judgeNote(head);
+
+			if (judge == JudgeType::None) break;
+
+			onJudge(notes, head, judge, captured);
+			judged = true;
+
+			if (judge != JudgeType::Miss) break;
+
+			notes.setRemovable(head);
+		}
+
+		return judged;
+	}
+
+public:
+	LaneEngine() {
+		const Array<InputGroup>& keys = Globals::laneKeys.at(LaneNum);
+
+		for (size_t lane = 0; lane < LaneCount; ++lane) {
+			m_keys[lane] = keys[lane];
+			m_events[lane].reserve(EventReserve);
+		}
+	}
+
+	/// @brief lane のノーツを count 個分確保する
+	void reserve(size_t lane, size_t count) {
+		if (LaneCount <= lane) return;
+
+		m_lanes[lane].reserve(count);
+
+		m_headY.reserve(m_headY.capacity() + count);
+		m_tailY.reserve(m_tailY.capacity() + count);
+	}
+
+	/// @brief ノーツをレーンの末尾に追加する
+	/// @param record 譜面のノーツ
+	/// @param offset 譜面の先頭の時間(マイクロ秒)
+	/// @remark レーン数を超えるノーツは無視する
+	void activate(const BeatmapBinary::NoteRecord& record, int64 offset) {
+		if (LaneCount <= record.lane) return;
+
+		const NoteType type = record.getType();
+
+		m_lanes[record.lane].push_back(type, record.lane, offset + record.timing, (type == NoteType::Hold) ? record.length : 0);
+	}
+
+	/// @brief 譜面のノーツに対応する有効なノーツを取り除く
+	/// @param record 譜面のノーツ
+	/// @param offset 譜面の先頭の時間(マイクロ秒)
+	void remove(const BeatmapBinary::NoteRecord& record, int64 offset) {
+		if (LaneCount <= record.lane) return;
+
+		NoteStore& notes = m_lanes[record.lane];
+
+		notes.removeIf([&](size_t i) {
+			return (notes.timing[i] == offset + record.timing) && (notes.type[i] == record.getType());
+		});
+	}
+
+	/// @brief このフレームの InputGroup の変化をキーの変化として追加する(入力スレッドを使わないとき)
+	/// @param time 変化したことにする時間(マイクロ秒)
+	/// @param captured 入力を読んだ時刻(Time::GetMicrosec)
+	void pollKeys(int64 time, uint64 captured) {
+		ForEachLane([&](auto lane) {
+			const InputGroup& key = m_keys[lane];
+
+			const bool down = key.down();
+			const bool up = key.up();
+
+			// 同じフレームで両方あったときは、今押されているかで順番を決める
+			if (up && (not down || key.pressed())) m_events[lane] << LaneEvent{ time, false, captured };
+			if (down) m_events[lane] << LaneEvent{ time, true, captured };
+			if (up && down && not key.pressed()) m_events[lane] << LaneEvent{ time, false, captured };
+		});
+	}
+
+	/// @brief 入力スレッドで記録したキーの変化を追加する
+	/// @param lane レーン
+	/// @param event 譜面上の時間に直したキーの変化(古い順に追加すること)
+	void addKeyEvent(uint8 lane, const LaneEvent& event) {
+		if (LaneCount <= lane) return;
+
+		m_events[lane] << event;
+	}
+
+	/// @brief レーンの先頭が最も早いノーツになるように時間順に戻す
+	void sortByTiming() {
+		for (auto& notes : m_lanes) {
+			notes.sortByTiming();
+		}
+	}
+
+	/// @brief t までのキーの変化と時間の経過でレーンごとに判定する
+	/// @tparam Window 判定幅 (JudgeWindow<Preset>)
+	/// @param t 判定する時間(マイクロ秒, 前回より後)
+	/// @param autoMode オートプレイ
+	/// @param onJudge 判定のたびに (const NoteStore&, size_t, JudgeType, uint64 captured) で呼ばれる
+	/// captured は判定のきっかけのキーの変化を記録した時刻(キーによらない判定なら0)
+	/// @remark キーの変化はそれぞれの変化の時間で判定し、t より後の変化は次に回す
+	/// そのあと t で、判定幅を過ぎたノーツやホールドの終点を判定する
+	template <class Window, class OnJudge>
+	void update(int64 t, bool autoMode, OnJudge&& onJudge) {
+		ForEachLane([&](auto lane) {
+			NoteStore& notes = m_lanes[lane];
+			Array<LaneEvent>& events = m_events[lane];
+
+			bool judged = false;
+
+			if (autoMode) {
+				judged = JudgeHead(notes, 0, [&](size_t head) { return UpdateAuto(notes, head, t); }, onJudge);
+
+				events.clear();
+			}
+			else {
+				size_t consumed = 0;
+
+				for (; consumed < events.size() && events[consumed].time <= t; ++consumed) {
+					const LaneEvent& event = events[consumed];
+					const LaneInput key = LaneInput::FromEvent(event);
+
+					judged |= JudgeHead(notes, event.captured, [&](size_t head) { return Note::Update<Window>(notes, head, event.time, key); }, onJudge);
+
+					m_held[lane] = event.pressed;
+				}
+
+				if (consumed) events.erase(events.begin(), events.begin() + consumed);
+
+				const LaneInput key = LaneInput::Holding(m_held[lane]);
+
+				judged |= JudgeHead(notes, 0, [&](size_t head) { return Note::Update<Window>(notes, head, t, key); }, onJudge);
+			}
+
+			// 判定がなければ消すノーツもない
+			if (judged) notes.removeJudged();
+		});
+	}
+
+	/// @param t 現在時間(マイクロ秒)
+	/// @param scroll スクロール速度
+	void draw(int64 t, double scroll) const {
+		const double pixelsPerMicro = NotePosition::PixelsPerMicro(scroll);
+
+		size_t count = 0;
+
+		ForEachLane([&](auto lane) { count += m_lanes[lane].size(); });
+
+		m_headY.resize(count);
+		m_tailY.resize(count);
+
+		// 描画の前に、全レーンのY座標をまとめて求めておく
+		size_t base = 0;
+
+		ForEachLane([&](auto lane) {
+			const NoteStore& notes = m_lanes[lane];
+
+			NotePosition::CalcY(notes.timing, {}, t, pixelsPerMicro, std::span{ m_headY }.subspan(base, notes.size()));
+			NotePosition::CalcY(notes.timing, notes.length, t, pixelsPerMicro, std::span{ m_tailY }.subspan(base, notes.size()));
+
+			base += notes.size();
+		});
+
+		base = 0;
+
+		ForEachLane([&](auto lane) {
+			const NoteStore& notes = m_lanes[lane];
+
+			for (size_t i = 0; i < notes.size(); ++i) {
+				const double y = m_headY[base + i];
+				const double tailY = m_tailY[base + i];
+
+				// 画面外(始点が上端より上 or 終点が下端より下)は描かない
+				if (y < -Globals::noteHeight || Globals::windowSize.y + Globals::noteHeight < tailY) continue;
+
+				Note::Draw(notes, i, StartX, y, tailY);
+			}
+
+			base += notes.size();
+		});
+	}
+
+	std::span<const NoteStore> lanes() const noexcept {
+		return m_lanes;
+	}
+
+	std::span<const InputGroup> keys() const noexcept {
+		return m_keys;
+	}
+};
+
+/// @brief 対応しているレーン数ごとの LaneEngine
+using LaneEngineVariant = std::variant<LaneEngine<4>, LaneEngine<6>, LaneEngine<7>, LaneEngine<8>>;
+
+/// @brief 譜面のレーン数を収められる LaneEngine を作る
+/// @param laneCount 譜面のレーン数
+/// @remark 対応していないレーン数なら例外を投げる
+inline LaneEngineVariant MakeLaneEngine(int32 laneCount) {
+	switch (laneCount) {
+	case 4: return LaneEngine<4>{};
+	case 6: return LaneEngine<6>{};
+	case 7: return LaneEngine<7>{};
+	case 8: return LaneEngine<8>{};
+	default: throw Error{ U"Unsupported lane count: {}"_fmt(laneCount) };
+	}
+}
@@ -0,0 +1,71 @@
+﻿#pragma once
+
+/// @brief 入力スレッドで記録したキーの変化
+struct KeyEvent {
+	/// @brief 変化した時刻(Time::GetMicrosec)
+	uint64 time = 0;
+
+	uint8 lane = 0;
+
+	/// @brief true なら押した、false なら離した
+	bool pressed = false;
+};
+
+/// @brief 譜面上の時間に直したキーの変化
+struct LaneEvent {
+	/// @brief 変化した時間(マイクロ秒)
+	int64 time = 0;
+
+	bool pressed = false;
+
+	/// @brief 変化を記録した時刻(Time::GetMicrosec), 遅れの計測に使う
+	uint64 captured = 0;
+};
+
+/// @brief ノーツの判定に渡すレーンの入力
+/// @remark InputGroup と同じ down / pressed / up で読めるようにしている
+/// キーの変化1つごとか、変化のない刻みごとに作る
+class LaneInput {
+	bool m_down = false;
+	bool m_up = false;
+
+	// 終わりに押されているか
+	bool m_held = false;
+
+public:
+	/// @brief キーの変化1つ分の入力
+	static LaneInput FromEvent(const LaneEvent& event) noexcept {
+		LaneInput input;
+
+		input.m_down = event.pressed;
+		input.m_up = not event.pressed;
+		input.m_held = event.pressed;
+
+		return input;
+	}
+
+	/// @brief 変化のない入力
+	/// @param held 押されているか
+	static LaneInput Holding(bool held) noexcept {
+		LaneInput input;
+
+		input.m_held = held;
+
+		return input;
+	}
+
+	/// @brief 押したか
+	bool down() const noexcept {
+		return m_down;
+	}
+
+	/// @brief 押されていたか(押して離した場合も含む)
+	bool pressed() const noexcept {
+		return m_held || m_down;
+	}
+
+	/// @brief 離したか
+	bool up() const noexcept {
+		return m_up;
+	}
+};
@@ -1,8 +0,0 @@
-﻿#pragma once
-
-enum class LaneType : int32 {
-	D = 0,
-	F,
-	J,
-	K
-};
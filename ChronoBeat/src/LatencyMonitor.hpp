@@ -0,0 +1,277 @@
+﻿#pragma once
+#include <Siv3D.hpp>
+
+/// @brief 遅れの分布(BinWidthMs ごとの数)
+class LatencyHistogram {
+public:
+	static constexpr double BinWidthMs = 0.25;
+
+	/// @brief 0 ~ 200ms, 超えたものは最後の枠に入れる
+	static constexpr size_t BinCount = 800;
+
+private:
+	std::array<uint32, BinCount + 1> m_bins{};
+
+	size_t m_count = 0;
+	double m_sumMs = 0.0;
+	double m_maxMs = 0.0;
+
+public:
+	/// @param micros 遅れ(マイクロ秒)
+	void add(uint64 micros) {
+		const double ms = micros / 1000.0;
+
+		++m_bins[Min(static_cast<size_t>(ms / BinWidthMs), BinCount)];
+
+		++m_count;
+		m_sumMs += ms;
+		m_maxMs = Max(m_maxMs, ms);
+	}
+
+	void clear() {
+		m_bins.fill(0);
+		m_count = 0;
+		m_sumMs = 0.0;
+		m_maxMs = 0.0;
+	}
+
+	size_t count() const noexcept {
+		return m_count;
+	}
+
+	double meanMs() const noexcept {
+		return m_count ? (m_sumMs / m_count) : 0.0;
+	}
+
+	double maxMs() const noexcept {
+		return m_maxMs;
+	}
+
+	/// @brief p (0~1) 分位の遅れ(ms)
+	/// @remark 枠の上端を返すので BinWidthMs だけ大きめになる
+	double percentileMs(double p) const {
+		if (m_count == 0) return 0.0;
+
+		const size_t rank = Max<size_t>(static_cast<size_t>(Math::Ceil(p * m_count)), 1);
+
+		size_t total = 0;
+
+		for (size_t bin = 0; bin < BinCount; ++bin) {
+			total += m_bins[bin];
+
+			if (rank <= total) return Min((bin + 1) * BinWidthMs, m_maxMs);
+		}
+
+		return m_maxMs;
+	}
+
+	std::span<const uint32> bins() const noexcept {
+		return m_bins;
+	}
+};
+
+/// @brief キーを押してから判定・音・判定表示・画面に出るまでの遅れを段階ごとに集計する
+/// @remark どの段階もキーの変化を入力スレッドで記録した時刻からの時間で測るので、
+/// 隣の段階との差がその段階にかかった時間になる。入力スレッドを使わないときはフレームの初めを押した時刻とする
+/// 計測はメインスレッドだけで行う (--latency のときだけ有効)
+class LatencyMonitor {
+public:
+	enum class Stage : uint8 {
+		/// @brief メインスレッドがキーの変化を受け取った
+		Pickup,
+		/// @brief ノーツを判定した
+		Judge,
+		/// @brief 判定音の playOneShot を呼び終えた
+		Sound,
+		/// @brief 判定表示を追加した
+		Effect,
+		/// @brief 判定表示を描いたフレームを表示した(System::Update から戻った)
+		Present,
+	};
+
+	static constexpr size_t StageCount = 5;
+
+	static constexpr std::array<StringView, StageCount> StageNames{
+		U"Pickup", U"Judge", U"Sound", U"Effect", U"Present"
+	};
+
+	inline static const FilePath ExportPath = U"latency.csv";
+
+	/// @brief 表示を待つ判定の数の上限(超えた分は測らない)
+	static constexpr size_t MaxPending = 256;
+
+private:
+	std::array<LatencyHistogram, StageCount> m_histograms;
+
+	/// @brief 判定表示を追加して、まだ画面に出ていないキーの変化の時刻
+	Array<uint64> m_pending;
+
+	bool m_isEnabled = false;
+	bool m_isVisible = true;
+
+public:
+	LatencyMonitor() {
+		m_pending.reserve(MaxPending);
+	}
+
+	void setEnabled(bool enabled) {
+		m_isEnabled = enabled;
+	}
+
+	bool isEnabled() const noexcept {
+		return m_isEnabled;
+	}
+
+	/// @brief captured から now までを stage の遅れとして記録する
+	/// @param captured キーの変化を記録した時刻(Time::GetMicrosec), 0 ならキーによらない判定なので記録しない
+	void record(Stage stage, uint64 captured, uint64 now = Time::GetMicrosec()) {
+		if (not m_isEnabled || captured == 0) return;
+
+		m_histograms[FromEnum(stage)].add(now - Min(captured, now));
+	}
+
+	/// @brief 判定表示を追加したキーの変化を、次に画面に出たときに記録する
+	void recordEffect(uint64 captured, uint64 now = Time::GetMicrosec()) {
+		if (not m_isEnabled || captured == 0) return;
+
+		record(Stage::Effect, captured, now);
+
+		if (m_pending.size() < MaxPending) m_pending << captured;
+	}
+
+	/// @brief フレームを表示した直後に呼ぶ(System::Update の後)
+	void onPresent(uint64 now = Time::GetMicrosec()) {
+		for (const uint64 captured : m_pending) {
+			record(Stage::Present, captured, now);
+		}
+
+		m_pending.clear();
+	}
+
+	void clear() {
+		for (auto& histogram : m_histograms) histogram.clear();
+
+		m_pending.clear();
+	}
+
+	const LatencyHistogram& histogram(Stage stage) const {
+		return m_histograms[FromEnum(stage)];
+	}
+
+	/// @brief F3 で表示の切り替え、F4 でファイルに出力、F5 で集計をやり直す
+	void update() {
+		if (not m_isEnabled) return;
+
+		if (KeyF3.down()) m_isVisible = not m_isVisible;
+		if (KeyF4.down()) exportCSV();
+		if (KeyF5.down()) clear();
+	}
+
+	/// @brief 段階ごとの分位と分布を描く
+	void draw() const {
+		if (not m_isEnabled || not m_isVisible) return;
+
+		const Font& font = FontAsset(U"Font.UI.Detail");
+
+		constexpr double LineHeight = 32.0;
+		constexpr double GraphWidth = 400.0;
+		constexpr double GraphRangeMs = 100.0;
+
+		const RectF region{ Arg::bottomLeft = Vec2{ 16, Scene::Height() - 16 }, 1200, LineHeight * (StageCount + 1) + 16 };
+
+		region.draw(ColorF{ 0.0, 0.75 });
+
+		Vec2 pos = region.pos.movedBy(8, 8);
+
+		// 文字幅がそろわないフォントなので、列ごとに位置を決めて描く
+		constexpr std::array<double, 6> ColumnX{ 0, 200, 300, 400, 500, 600 };
+
+		const auto drawRow = [&](const std::array<String, 6>& columns) {
+			for (size_t i = 0; i < columns.size(); ++i) {
+				font(columns[i]).draw(pos.movedBy(ColumnX[i], 0));
+			}
+		};
+
+		drawRow({ U"from key (ms)", U"n", U"p50", U"p95", U"p99", U"max" });
+
+		font(U"F3 hide / F4 export / F5 reset").draw(Arg::topRight = pos.movedBy(region.w - 16, 0), Palette::Gray);
+
+		for (size_t stage = 0; stage < StageCount; ++stage) {
+			pos.moveBy(0, LineHeight);
+
+			const LatencyHistogram& histogram = m_histograms[stage];
+
+			drawRow({
+				String{ StageNames[stage] }, Format(histogram.count()),
+				U"{:.2f}"_fmt(histogram.percentileMs(0.5)), U"{:.2f}"_fmt(histogram.percentileMs(0.95)),
+				U"{:.2f}"_fmt(histogram.percentileMs(0.99)), U"{:.2f}"_fmt(histogram.maxMs())
+			});
+
+			if (histogram.count() == 0) continue;
+
+			// 0 ~ GraphRangeMs の分布(最も多い枠を高さいっぱいにする)
+			const auto bins = histogram.bins();
+			const size_t graphBins = static_cast<size_t>(GraphRangeMs / LatencyHistogram::BinWidthMs);
+			const uint32 peak = Max<uint32>(*std::max_element(bins.begin(), bins.begin() + graphBins), 1);
+
+			const Vec2 graphPos = pos.movedBy(region.w - GraphWidth - 24, LineHeight - 6);
+
+			for (size_t bin = 0; bin < graphBins; ++bin) {
+				if (bins[bin] == 0) continue;
+
+				const double height = (LineHeight - 8) * bins[bin] / peak;
+
+				RectF{ Arg::bottomLeft = graphPos.movedBy(GraphWidth * bin / graphBins, 0), GraphWidth / graphBins, height }.draw(Palette::Orange);
+			}
+		}
+	}
+
+	/// @brief 段階ごとの集計と分布を CSV に出力する
+	/// @return 出力できたか
+	bool exportCSV(const FilePath& path = ExportPath) const {
+		TextWriter writer{ path };
+
+		if (not writer) {
+			Logger << U"LatencyMonitor: failed to write {}"_fmt(path);
+			return false;
+		}
+
+		writer.writeln(U"stage,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms");
+
+		for (size_t stage = 0; stage < StageCount; ++stage) {
+			const LatencyHistogram& histogram = m_histograms[stage];
+
+			writer.writeln(U"{},{},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f}"_fmt(
+				StageNames[stage], histogram.count(), histogram.meanMs(),
+				histogram.percentileMs(0.5), histogram.percentileMs(0.95), histogram.percentileMs(0.99), histogram.maxMs()));
+		}
+
+		writer.writeln(U"");
+
+		// 分布: 枠の下端(ms)と段階ごとの数
+		String header = U"bin_ms";
+
+		for (const auto& name : StageNames) {
+			header += U',';
+			header += name;
+		}
+
+		writer.writeln(header);
+
+		for (size_t bin = 0; bin <= LatencyHistogram::BinCount; ++bin) {
+			String line = Format(bin * LatencyHistogram::BinWidthMs);
+			bool isEmpty = true;
+
+			for (const auto& histogram : m_histograms) {
+				line += U",{}"_fmt(histogram.bins()[bin]);
+				isEmpty &= (histogram.bins()[bin] == 0);
+			}
+
+			if (not isEmpty) writer.writeln(line);
+		}
+
+		Logger << U"LatencyMonitor: exported to {}"_fmt(path);
+
+		return true;
+	}
+};
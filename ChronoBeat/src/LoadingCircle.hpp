@@ -21,6 +21,14 @@ public:
 		}
 	}
 
+	/// @brief 進捗を円弧で表示します。
+	/// @param progress 進捗 (0.0 ~ 1.0)
+	static void SetProgress(double progress) {
+		if (auto p = Addon::GetAddon<LoadingCircleAddon>(U"LoadingCircleAddon")) {
+			p->m_progress = Clamp(progress, 0.0, 1.0);
+		}
+	}
+
 	/// @brief ロード中の円の描画が有効かを返します。
 	[[nodiscard]]
 	static bool IsActive() {
@@ -68,6 +76,10 @@ private:
 		}
 
 		m_trail.draw();
+
+		if (m_progress) {
+			m_circle.drawArc(0_deg, (*m_progress * 360_deg), (m_thickness / 2), (m_thickness / 2), m_color);
+		}
 	}
 
 	static constexpr double LifeTime = 1.5;
@@ -90,11 +102,14 @@ private:
 
 	bool m_active = false;
 
+	Optional<double> m_progress;
+
 	void begin(const Circle& circle, double thickness, const ColorF& color) {
 		m_circle = circle;
 		m_thickness = thickness;
 		m_color = color;
 		m_active = true;
+		m_progress.reset();
 
 		// 開始時点で十分な長さの軌跡を生成しておく
 		prewarm();
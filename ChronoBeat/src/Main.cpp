@@ -3,20 +3,83 @@
 #include "Scene/Common.hpp"
 
 #include "SongInfo.hpp"
+#include "SongLibraryScanner.hpp"
 
 #include "Scene/TitleScene.hpp"
 #include "Scene/SelectScene.hpp"
 #include "Scene/SettingScene.hpp"
+#include "Scene/CalibrationScene.hpp"
 #include "Scene/GameScene.hpp"
 #include "Scene/ResultScene.hpp"
 
 #include "LoadingCircle.hpp"
 #include "LeaderBoard.hpp"
+#include "BeatmapConverter.hpp"
+#include "BeatmapValidator.hpp"
+#include "Benchmark.hpp"
 #include "_environment.hpp"
 
 void Main() {
 	Window::SetTitle(Globals::gameVersion.withTitle(Globals::gameTitle));
 
+	const Array<String> args = System::GetCommandLineArgs();
+
+	// 譜面の事前コンパイル (ChronoBeat.exe --convert-beatmaps)
+	if (args.includes(U"--convert-beatmaps")) {
+		const size_t converted = BeatmapConverter::ConvertAll(Globals::BeatmapBaseDir);
+
+		System::MessageBoxOK(U"{} beatmap(s) converted."_fmt(converted));
+		return;
+	}
+
+	// 譜面の検証と正規化 (ChronoBeat.exe --validate-beatmaps [出力先])
+	// 終了コードは不正な譜面があれば 1、なければ 0
+	if (auto it = std::ranges::find(args, U"--validate-beatmaps"); it != args.end()) {
+		Window::Minimize();
+
+		const size_t failed = BeatmapValidator::ValidateAll(Globals::BeatmapBaseDir, (std::next(it) != args.end()) ? *std::next(it) : FilePath{});
+
+		// レポートは ValidateAll の中で閉じて書き出し済み
+		std::exit(failed ? 1 : 0);
+	}
+
+	// 譜面読み込みのベンチマーク (ChronoBeat.exe --bench-beatmap <json>)
+	if (auto it = std::ranges::find(args, U"--bench-beatmap"); (it != args.end()) && (std::next(it) != args.end())) {
+		Benchmark::BeatmapLoad(*std::next(it));
+		return;
+	}
+
+	// ノーツ更新のベンチマーク (ChronoBeat.exe --bench-scheduler)
+	if (args.includes(U"--bench-scheduler")) {
+		Benchmark::NoteScheduler();
+		return;
+	}
+
+	// ノーツの種類ごとの呼び分けのベンチマーク (ChronoBeat.exe --bench-dispatch)
+	if (args.includes(U"--bench-dispatch")) {
+		Benchmark::NoteDispatch();
+		return;
+	}
+
+	// ノーツのY座標計算のベンチマーク (ChronoBeat.exe --bench-note-position)
+	if (args.includes(U"--bench-note-position")) {
+		Benchmark::NotePositions();
+		return;
+	}
+
+	// 曲ライブラリ登録のベンチマーク (ChronoBeat.exe --bench-library <count>)
+	if (auto it = std::ranges::find(args, U"--bench-library"); it != args.end()) {
+		Benchmark::SongLibraryRegistration((std::next(it) != args.end()) ? ParseOr<size_t>(*std::next(it), 500) : 500);
+		return;
+	}
+
+	// 譜面制作用: プレイ中に譜面の保存を反映する (ChronoBeat.exe --hot-reload)
+	Globals::isHotReloadEnabled = args.includes(U"--hot-reload");
+
+	// 入力から音・画面までの遅れを計測して表示する (ChronoBeat.exe --latency)
+	// F3 で表示の切り替え、F4 と終了時に latency.csv に出力する
+	Globals::latencyMonitor.setEnabled(args.includes(U"--latency"));
+
 	///////////////////
 	// Asset register
 	///////////////////
@@ -78,6 +141,7 @@ void Main() {
 		.add<TitleScene>(SceneState::Title)
 		.add<SelectScene>(SceneState::Select)
 		.add<SettingScene>(SceneState::Setting)
+		.add<CalibrationScene>(SceneState::Calibration)
 		.add<GameScene>(SceneState::Game)
 		.add<ResultScene>(SceneState::Result);
 
@@ -88,20 +152,13 @@ void Main() {
 	/////////////////////
 	// songs and jacket
 	/////////////////////
-	const JSON infoJson = JSON::Load(Resource(U"songinfo.json"));
-	for (const JSON& data : infoJson.arrayView()) {
-		SongInfo info{ data };
+	// 曲ライブラリは変更のあった曲フォルダだけを読み直す
+	Globals::songLibrary = SongLibrary{ Globals::SongLibraryIndexPath, Globals::BeatmapBaseDir, U"songinfo.json" };
 
-		Globals::songInfos << info.registerAsset();
+	// ファイルの確認は裏で並列に行い、終わったものからライブラリの順に登録する
+	SongLibraryScanner songScanner{ Globals::songLibrary.records() };
 
-		rankingRequests[info.title] = LeaderBoard::CreateGetTask(Environment::LeaderboardURLRaw, info.title, 5);
-		Globals::records[info.title] = {};
-	}
-
-#if SIV3D_BUILD(DEBUG)
-	Console << U"Registered";
-	Console << Globals::songInfos;
-#endif
+	LoadingCircleAddon::Begin(Circle{ Globals::windowSize.x - 56.0, 56.0, 40.0 }, 2.0, Palette::White);
 
 	Window::Resize(Globals::windowSize);
 	Scene::SetResizeMode(ResizeMode::Keep);
@@ -111,8 +168,34 @@ void Main() {
 	Scene::SetBackground(Globals::Theme::backgroundBase);
 
 	while (System::Update()) {
+		// 前のフレームが表示された
+		Globals::latencyMonitor.onPresent();
+
 		if (not manager.update()) break;
 
+		// 曲ライブラリ読み込み
+		if (not Globals::isSongLibraryLoaded) {
+			for (const SongInfo& info : songScanner.takeReady()) {
+				Globals::songInfos << info.registerAsset();
+
+				rankingRequests[info.title] = LeaderBoard::CreateGetTask(Environment::LeaderboardURLRaw, info.title, 5);
+				Globals::records[info.title] = {};
+			}
+
+			LoadingCircleAddon::SetProgress(songScanner.progress());
+
+			if (songScanner.isDone()) {
+				Globals::isSongLibraryLoaded = true;
+
+				LoadingCircleAddon::End();
+
+#if SIV3D_BUILD(DEBUG)
+				Console << U"Registered";
+				Console << Globals::songInfos;
+#endif
+			}
+		}
+
 		// ランキング読み込み
 		if (0 < rankingRequests.size()) {
 			for (auto it = rankingRequests.begin(); it != rankingRequests.end();) {
@@ -152,5 +235,12 @@ void Main() {
 
 		Circle{ Scene::Center(), Globals::windowSize.x }
 			.draw(ColorF{ .0, .0 }, Palette::Black.withAlpha(128));
+
+		Globals::latencyMonitor.update();
+		Globals::latencyMonitor.draw();
+	}
+
+	if (Globals::latencyMonitor.isEnabled()) {
+		Globals::latencyMonitor.exportCSV();
 	}
 }
@@ -1,115 +1,46 @@
 ﻿#include "Note.hpp"
 
 /////////////////////////////
-// Base Note
+// Common
 /////////////////////////////
 
-Note::Note(int32 _lane, double t, double sp = 1.0) :
-	lane{ _lane }, timing{ t }, speed{ sp } {
-
-}
-
-std::shared_ptr<Note> Note::Make(NoteType ntype, int32 lane, double t, double sp = 1.0) {
-	if (ntype == NoteType::Tap) return std::make_shared<TapNote>(lane, t, sp);
-	if (ntype == NoteType::Stay) return std::make_shared<StayNote>(lane, t, sp);
-	if (ntype == NoteType::Hold) throw Error{ U"Hold note needs length argment" };
-
-	return nullptr;
-}
-
-std::shared_ptr<Note> Note::Make(NoteType ntype, int32 lane, double t, double len, double sp = 1.0) {
-	if (ntype != NoteType::Hold) throw Error{ U"!Hold note doesn't use length argment" };
-
-	return std::make_shared<HoldNote>(lane, t, len, sp);
-}
-
-LaneType Note::getLaneType() const {
-	return static_cast<LaneType>(lane);
-}
-
-JudgeType Note::getJudge(double t) const {
-	const double diff = timeDiff(t);
-
-	int32 minTiming = Globals::judgeTimings[JudgeType::Near];
-
-	if (diff * 1000 < -minTiming) return JudgeType::Miss;
-
-	const double adiff = Math::Abs(diff);
-	minTiming += 1;
-
-	JudgeType result = JudgeType::None;
-
-	for (auto&& [type, millis] : Globals::judgeTimings) {
-		if (minTiming <= millis) continue;
-
-		if (adiff * 1000 <= millis) {
-			minTiming = millis;
-			result = type;
-		}
-	}
-
-	return result;
-}
-
-InputGroup Note::getControllKey() const {
-	return Globals::controllKeys[getLaneType()];
-}
-
-NoteType Note::GetType(Note* note) {
-	if (dynamic_cast<TapNote*>(note) != nullptr) return NoteType::Tap;
-	if (dynamic_cast<HoldNote*>(note) != nullptr) return NoteType::Hold;
-	if (dynamic_cast<StayNote*>(note) != nullptr) return NoteType::Stay;
-
-	return NoteType::Tap;
-}
-
-double Note::GetTimingFromJson(const JSON& json, double bpm) {
+int64 Note::GetTimingFromJson(const JSON& json, double bpm) {
 	const int32 lpb = json[U"LPB"].get<int32>();
 	const int32 num = json[U"num"].get<int32>();
 
 	double blockPerTime = 60.0 / bpm;
 
-	return (blockPerTime / lpb) * num;
-}
-
-double Note::timeDiff(double t) const {
-	return timing - t;
-}
-
-inline double Note::calcX() const {
-	return Globals::laneStartX + (Note::NoteMergin / 2) + (Globals::laneWidth * lane);
+	// ここで一度だけ丸め、以降はマイクロ秒の整数で扱う
+	return Timeline::FromSec((blockPerTime / lpb) * num);
 }
 
-inline double Note::calcY(double t, double scroll) const {
-	return Globals::judgeLineY - (timeDiff(t) * Globals::defaultNoteSpeed) * (Globals::speed * scroll * speed);
+double Note::CalcX(double startX, uint8 lane) {
+	return startX + (NoteMergin / 2) + (Globals::laneWidth * lane);
 }
 
-inline Vec2 Note::calcPos(double t, double scroll) const {
-	return Vec2{ calcX(), calcY(t, scroll) };
+double Note::CalcY(int64 timing, int64 t, double scroll) {
+	return Globals::judgeLineY - static_cast<double>(timing - t) * NotePosition::PixelsPerMicro(scroll);
 }
 
 /////////////////////////////
 // TapNote
 /////////////////////////////
 
-TapNote::TapNote(int32 lane, double t, double sp) : Note(lane, t, sp) {
-
-}
-
-JudgeType TapNote::update(double t) {
-	JudgeType result = getJudge(t);
+template <class Window>
+JudgeType Note::Kind<NoteType::Tap>::Update(NoteStore& notes, size_t i, int64 t, const LaneInput& key) {
+	JudgeType result = Window::Classify(notes.timing[i] - t);
 
 	if (result == JudgeType::Miss) return result;
-	if (not getControllKey().down()) return JudgeType::None;
+	if (not key.down()) return JudgeType::None;
 
-	if(result != JudgeType::None)
-		isRemovable = true;
+	if (result != JudgeType::None)
+		notes.setRemovable(i);
 
 	return result;
 }
 
-void TapNote::draw(double t, double scroll) const {
-	const Vec2 pos = calcPos(t, scroll);
+void Note::Kind<NoteType::Tap>::Draw(const NoteStore& notes, size_t i, double startX, double y, double tailY) {
+	const Vec2 pos{ Note::CalcX(startX, notes.lane[i]), y };
 
 	RectF rect{ pos.x, pos.y - Globals::noteHeight / 2, Globals::laneWidth - Note::NoteMergin, Globals::noteHeight };
 
@@ -120,115 +51,93 @@ void TapNote::draw(double t, double scroll) const {
 // HoldNote
 /////////////////////////////
 
-HoldNote::HoldNote(int32 lane, double t, double len, double sp) : Note(lane, t, sp), length{ len } {
-
-}
-
-JudgeType HoldNote::getJudge(double t, double len = .0) const {
-	const double diff = timeDiff(t - len);
-	int32 minTiming = Globals::judgeTimings[JudgeType::Near];
+template <class Window>
+JudgeType Note::Kind<NoteType::Hold>::Update(NoteStore& notes, size_t i, int64 t, const LaneInput& key) {
+	JudgeType result = Window::Classify(notes.timing[i] - t);
 
-	if (diff * 1000 < -minTiming) return JudgeType::Miss;
-
-	const double adiff = Math::Abs(diff);
-	minTiming += 1;
-	
-	JudgeType result = JudgeType::None;
-
-	for (auto&& [type, millis] : Globals::judgeTimings) {
-		if (minTiming <= millis) continue;
-
-		if (adiff * 1000 <= millis) {
-			minTiming = millis;
-			result = type;
-		}
-	}
-
-	return result;
-}
-
-JudgeType HoldNote::update(double t) {
-	const InputGroup key = getControllKey();
-
-	JudgeType result = getJudge(t);
-
-	if (not isHolding) {
+	if (not notes.isHolding(i)) {
 		if (result == JudgeType::Miss) return result;
 
-		/*
-		// 始点が通り過ぎたら無視
-		if (timeDiff(t) < -Globals::judgeTimings[JudgeType::Near])
-			return JudgeType::None;
-		*/
-
 		// 判定したなら holding
 		if (key.down() && result != JudgeType::None) {
-			isHolding = true;
+			notes.setHolding(i);
 			return result;
 		}
 
 		return JudgeType::None;
 	}
 
-	if (isHolding) {
-		result = getJudge(t, length);
+	result = Window::Classify(notes.timing[i] + notes.length[i] - t);
 
-		// ホールド終点まで長押ししてるならPerfect
-		if (result == JudgeType::Perfect) {
-			isRemovable = true;
-			return result;
-		}
+	// ホールド終点まで長押ししてるならPerfect
+	if (result == JudgeType::Perfect) {
+		notes.setRemovable(i);
+		return result;
+	}
 
-		// ホールド中にキーを離す
-		if (key.up()) {
-			isRemovable = true;
+	// ホールド中にキーを離す
+	if (key.up()) {
+		notes.setRemovable(i);
 
-			// なにも判定できない = 早すぎる
-			if (result == JudgeType::None) return JudgeType::Miss;
+		// なにも判定できない = 早すぎる
+		if (result == JudgeType::None) return JudgeType::Miss;
 
-			return result;
-		}
+		return result;
 	}
 
 	return JudgeType::None;
 }
-void HoldNote::draw(double t, double scroll) const {
-	const Vec2 pos = calcPos(t, scroll);
-	const double target = calcY(t - length, scroll);
+
+void Note::Kind<NoteType::Hold>::Draw(const NoteStore& notes, size_t i, double startX, double y, double tailY) {
+	const Vec2 pos{ Note::CalcX(startX, notes.lane[i]), y };
 
 	// to -> from
-	RectF rect{ pos.x, target - (Globals::noteHeight / 2), Globals::laneWidth - Note::NoteMergin, pos.y - target + (Globals::noteHeight) };
+	RectF rect{ pos.x, tailY - (Globals::noteHeight / 2), Globals::laneWidth - Note::NoteMergin, pos.y - tailY + (Globals::noteHeight) };
 
-	rect.rounded(2).draw(isHolding ? Palette::Gray : Palette::White);
+	rect.rounded(2).draw(notes.isHolding(i) ? Palette::Gray : Palette::White);
 }
 
 /////////////////////////////
 // StayNote
 /////////////////////////////
-StayNote::StayNote(int32 lane, double t, double sp) : Note(lane, t, sp) {
-
-}
 
-JudgeType StayNote::update(double t) {
-	JudgeType result = getJudge(t);
+template <class Window>
+JudgeType Note::Kind<NoteType::Stay>::Update(NoteStore& notes, size_t i, int64 t, const LaneInput& key) {
+	JudgeType result = Window::Classify(notes.timing[i] - t);
 
 	if (result == JudgeType::Miss) return result;
 
-	if (not getControllKey().pressed()) return JudgeType::None;
-	if (0 < timeDiff(t)) return JudgeType::None;
+	if (not key.pressed()) return JudgeType::None;
+	if (0 < notes.timing[i] - t) return JudgeType::None;
 
 	if (result != JudgeType::None) {
 		result = JudgeType::Perfect;
-		isRemovable = true;
+		notes.setRemovable(i);
 	}
 
 	return result;
 }
 
-void StayNote::draw(double t, double scroll) const {
-	const Vec2 pos = calcPos(t, scroll);
+void Note::Kind<NoteType::Stay>::Draw(const NoteStore& notes, size_t i, double startX, double y, double tailY) {
+	const Vec2 pos{ Note::CalcX(startX, notes.lane[i]), y };
 
 	RectF rect{ pos.x, pos.y - Globals::noteHeight / 2, Globals::laneWidth - Note::NoteMergin, Globals::noteHeight };
 
 	rect.rounded(2).draw(Palette::Yellow);
 }
+
+/////////////////////////////
+// Dispatch
+/////////////////////////////
+
+template <class Window>
+JudgeType Note::Update(NoteStore& notes, size_t i, int64 t, const LaneInput& key) {
+	return Visit(notes.type[i], [&](auto kind) { return decltype(kind)::template Update<Window>(notes, i, t, key); });
+}
+
+template JudgeType Note::Update<JudgeWindow<JudgePreset::Normal>>(NoteStore&, size_t, int64, const LaneInput&);
+template JudgeType Note::Update<JudgeWindow<JudgePreset::Strict>>(NoteStore&, size_t, int64, const LaneInput&);
+
+void Note::Draw(const NoteStore& notes, size_t i, double startX, double y, double tailY) {
+	Visit(notes.type[i], [&](auto kind) { decltype(kind)::Draw(notes, i, startX, y, tailY); });
+}
@@ -1,97 +1,83 @@
 ﻿#pragma once
 #include "NoteType.hpp"
-#include "LaneType.hpp"
 #include "JudgeType.hpp"
+#include "NoteStore.hpp"
+#include "LaneInput.hpp"
+#include "JudgeWindow.hpp"
+#include "Timeline.hpp"
+#include "NotePosition.hpp"
 #include "Globals.hpp"
 
-struct Note {
-	static constexpr int32 NoteMergin = 8;
-
-	// 0 ~ 3
-	int32 lane = 0;
-	double timing = .0;
-	double speed = 1.0;
-	bool isRemovable = false;
-
-	size_t priority = 0;
-
-	Note(int32, double, double);
-
-	virtual ~Note() = default;
-
-	/// @brief ノーツの作成(Hold以外
-	/// @param type ノーツのタイプ
-	/// @param lane どこのレーンか
-	/// @param t タイミング
-	/// @param speed 速度
-	/// @return 作られたノーツ
-	static std::shared_ptr<Note> Make(NoteType type, int32 lane, double t, double speed);
-
-	/// @brief ノーツの作成(Holdのみ
-	/// @param type ノーツのタイプ
-	/// @param lane どこのレーンか
-	/// @param t タイミング
-	/// @param speed 速度
-	/// @param length ノーツの長さ
-	/// @return 作られたノーツ
-	static std::shared_ptr<Note> Make(NoteType type, int32 lane, double t, double length, double speed);
-
-	/// @brief lane番号からLaneTypeに変換
-	/// @return LaneType
-	LaneType getLaneType() const;
-
-	JudgeType getJudge(double) const;
-
-	InputGroup getControllKey() const;
-
-	static NoteType GetType(Note*);
-
-	static double GetTimingFromJson(const JSON&, double);
-
-	/// @brief tとノーツのタイミングの時間差を返す
-	/// @param t 現在時間
-	/// @return tとノーツのタイミングの時間差
-	double timeDiff(double t) const;
-
-	inline double calcX() const;
-	inline double calcY(double, double) const;
-	inline Vec2 calcPos(double, double) const;
-
-	[[nodiscard]] virtual JudgeType update(double) = 0;
-
-	virtual void draw(double, double) const = 0;
-};
-
-struct TapNote : Note {
-	TapNote(int32, double, double);
-	
-	[[nodiscard]] JudgeType update(double) override;
-
-	void draw(double, double) const override;
-};
-
-struct HoldNote : Note {
-	double length = .0;
-	bool isHolding = false;
-
-	/// @brief コンストラクタ
-	/// @param lane どこのレーンか
-	/// @param t 始点の時間ms
-	/// @param length 終点の時間ms
-	/// @param speed 速度
-	HoldNote(int32 lane, double t, double length, double speed);
-
-	JudgeType getJudge(double, double) const;
-
-	[[nodiscard]] JudgeType update(double) override;
-
-	void draw(double t, double) const override;
-};
-
-struct StayNote : Note {
-	StayNote(int32 lane, double t, double sp);
-
-	[[nodiscard]] JudgeType update(double t) override;
-
-	void draw(double t, double speed) const override;
-};
+/// @brief NoteStore の i 番目のノーツの判定と描画
+/// @remark ノーツの種類ごとの処理は NoteStore::type のタグで Kind に振り分ける
+namespace Note {
+	inline constexpr int32 NoteMergin = 8;
+
+	/// @brief JSONのノーツの LPB/num からタイミングを得る
+	/// @return 譜面の先頭からの時間(マイクロ秒)
+	int64 GetTimingFromJson(const JSON&, double);
+
+	/// @param startX レーンの左端
+	double CalcX(double startX, uint8 lane);
+
+	/// @remark 描画では NotePosition::CalcY でまとめて求める
+	double CalcY(int64 timing, int64 t, double scroll);
+
+	/// @brief ノーツの種類ごとの判定と描画
+	/// @remark 仮想関数ではなく、種類ごとに別の型にして静的に呼び分ける
+	/// Window は JudgeWindow<Preset> で、判定幅もコンパイル時に決まる
+	/// key はノーツのレーンの入力、startX はレーンの左端、y / tailY は始点 / 終点の NotePosition::CalcY
+	template <NoteType Type>
+	struct Kind;
+
+	template <>
+	struct Kind<NoteType::Tap> {
+		template <class Window>
+		static JudgeType Update(NoteStore& notes, size_t i, int64 t, const LaneInput& key);
+		static void Draw(const NoteStore& notes, size_t i, double startX, double y, double tailY);
+	};
+
+	template <>
+	struct Kind<NoteType::Hold> {
+		template <class Window>
+		static JudgeType Update(NoteStore& notes, size_t i, int64 t, const LaneInput& key);
+		static void Draw(const NoteStore& notes, size_t i, double startX, double y, double tailY);
+	};
+
+	template <>
+	struct Kind<NoteType::Stay> {
+		template <class Window>
+		static JudgeType Update(NoteStore& notes, size_t i, int64 t, const LaneInput& key);
+		static void Draw(const NoteStore& notes, size_t i, double startX, double y, double tailY);
+	};
+
+	/// @brief 種類のタグに対応する Kind を渡して f を呼ぶ
+	/// @param type ノーツの種類
+	/// @param f Kind<Type> を受け取る関数
+	template <class F>
+	decltype(auto) Visit(NoteType type, F&& f) {
+		switch (type) {
+		case NoteType::Hold: return f(Kind<NoteType::Hold>{});
+		case NoteType::Stay: return f(Kind<NoteType::Stay>{});
+		default: return f(Kind<NoteType::Tap>{});
+		}
+	}
+
+	/// @brief ノーツの判定
+	/// @param notes ノーツ
+	/// @param i インデックス
+	/// @param t 判定する時間(マイクロ秒), キーの変化で判定するときはその変化の時間
+	/// @param key ノーツのレーンの入力(キーの変化1つ分, またはフレーム分)
+	/// @return 判定, なにもなければNone
+	/// @tparam Window 判定幅 (JudgeWindow<Preset>)
+	template <class Window>
+	[[nodiscard]] JudgeType Update(NoteStore& notes, size_t i, int64 t, const LaneInput& key);
+
+	/// @brief ノーツの描画
+	/// @param notes ノーツ
+	/// @param i インデックス
+	/// @param startX レーンの左端
+	/// @param y 始点のY座標
+	/// @param tailY 終点のY座標(Hold以外は y と同じ)
+	void Draw(const NoteStore& notes, size_t i, double startX, double y, double tailY);
+}
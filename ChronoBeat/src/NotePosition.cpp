@@ -0,0 +1,126 @@
+﻿#include "NotePosition.hpp"
+#include <intrin.h>
+#include <immintrin.h>
+
+namespace {
+	// int64 -> double の変換に使う 2^52 + 2^51
+	// AVX2 には int64 -> double の変換がないので、仮数部に整数を足して作る(|x| < 2^51 で正確)
+	constexpr int64 MagicBits = 0x4338'0000'0000'0000;
+	constexpr double Magic = 6755399441055744.0;
+
+	double CalcYOne(int64 diff, double judgeLineY, double pixelsPerMicro) {
+		return judgeLineY - static_cast<double>(diff) * pixelsPerMicro;
+	}
+
+	void CalcYScalar(const int64* timing, const int64* length, size_t count, int64 t, double pixelsPerMicro, double* out) {
+		const double judgeLineY = Globals::judgeLineY;
+
+		for (size_t i = 0; i < count; ++i) {
+			const int64 diff = timing[i] + (length ? length[i] : 0) - t;
+
+			out[i] = CalcYOne(diff, judgeLineY, pixelsPerMicro);
+		}
+	}
+
+	void CalcYSSE2(const int64* timing, const int64* length, size_t count, int64 t, double pixelsPerMicro, double* out) {
+		const __m128i tv = _mm_set1_epi64x(t);
+		const __m128i magicBits = _mm_set1_epi64x(MagicBits);
+		const __m128d magic = _mm_set1_pd(Magic);
+		const __m128d judgeLineY = _mm_set1_pd(Globals::judgeLineY);
+		const __m128d scale = _mm_set1_pd(pixelsPerMicro);
+
+		size_t i = 0;
+
+		for (; i + 2 <= count; i += 2) {
+			__m128i diff = _mm_loadu_si128(reinterpret_cast<const __m128i*>(timing + i));
+
+			if (length) diff = _mm_add_epi64(diff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(length + i)));
+
+			diff = _mm_sub_epi64(diff, tv);
+
+			const __m128d d = _mm_sub_pd(_mm_castsi128_pd(_mm_add_epi64(diff, magicBits)), magic);
+
+			_mm_storeu_pd(out + i, _mm_sub_pd(judgeLineY, _mm_mul_pd(d, scale)));
+		}
+
+		CalcYScalar(timing + i, length ? length + i : nullptr, count - i, t, pixelsPerMicro, out + i);
+	}
+
+	void CalcYAVX2(const int64* timing, const int64* length, size_t count, int64 t, double pixelsPerMicro, double* out) {
+		const __m256i tv = _mm256_set1_epi64x(t);
+		const __m256i magicBits = _mm256_set1_epi64x(MagicBits);
+		const __m256d magic = _mm256_set1_pd(Magic);
+		const __m256d judgeLineY = _mm256_set1_pd(Globals::judgeLineY);
+		const __m256d scale = _mm256_set1_pd(pixelsPerMicro);
+
+		size_t i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			__m256i diff = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(timing + i));
+
+			if (length) diff = _mm256_add_epi64(diff, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(length + i)));
+
+			diff = _mm256_sub_epi64(diff, tv);
+
+			const __m256d d = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(diff, magicBits)), magic);
+
+			// FMA を使うとスカラーと結果が変わるので、乗算と減算を分けている
+			_mm256_storeu_pd(out + i, _mm256_sub_pd(judgeLineY, _mm256_mul_pd(d, scale)));
+		}
+
+		CalcYSSE2(timing + i, length ? length + i : nullptr, count - i, t, pixelsPerMicro, out + i);
+	}
+}
+
+NotePosition::Isa NotePosition::DetectIsa() {
+	std::array<int32, 4> info{};
+
+	__cpuid(info.data(), 0);
+	const int32 maxLeaf = info[0];
+
+	if (maxLeaf < 1) return Isa::Scalar;
+
+	__cpuid(info.data(), 1);
+
+	const bool sse2 = (info[3] & (1 << 26)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+
+	if (not sse2) return Isa::Scalar;
+
+	// OS が YMM レジスタを保存するか
+	if (maxLeaf < 7 || not osxsave || not avx || (_xgetbv(0) & 0b110) != 0b110) return Isa::SSE2;
+
+	__cpuidex(info.data(), 7, 0);
+
+	const bool avx2 = (info[1] & (1 << 5)) != 0;
+
+	return avx2 ? Isa::AVX2 : Isa::SSE2;
+}
+
+NotePosition::Isa NotePosition::ActiveIsa() {
+	static const Isa isa = DetectIsa();
+
+	return isa;
+}
+
+StringView NotePosition::GetIsaName(Isa isa) {
+	switch (isa) {
+	case Isa::AVX2: return U"avx2";
+	case Isa::SSE2: return U"sse2";
+	default: return U"scalar";
+	}
+}
+
+void NotePosition::CalcY(std::span<const int64> timing, std::span<const int64> length, int64 t, double pixelsPerMicro, std::span<double> out, Isa isa) {
+	assert(timing.size() <= out.size());
+	assert(length.empty() || timing.size() <= length.size());
+
+	const int64* lengthData = length.empty() ? nullptr : length.data();
+
+	switch (isa) {
+	case Isa::AVX2: CalcYAVX2(timing.data(), lengthData, timing.size(), t, pixelsPerMicro, out.data()); break;
+	case Isa::SSE2: CalcYSSE2(timing.data(), lengthData, timing.size(), t, pixelsPerMicro, out.data()); break;
+	default: CalcYScalar(timing.data(), lengthData, timing.size(), t, pixelsPerMicro, out.data()); break;
+	}
+}
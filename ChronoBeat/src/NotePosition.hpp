@@ -0,0 +1,38 @@
+﻿#pragma once
+#include "Globals.hpp"
+
+/// @brief ノーツの画面上のY座標をまとめて計算する
+/// @remark ノーツごとに描画の中で計算せず、描画の前にタイミングの配列から一度に求める
+/// CPU が対応していれば AVX2 / SSE2 で計算する
+namespace NotePosition {
+	/// @brief 使う命令セット
+	enum class Isa : int32 {
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	/// @brief この CPU で使える最も速い命令セット
+	Isa DetectIsa();
+
+	/// @brief CalcY で使う命令セット(起動後最初に呼んだときに決まる)
+	Isa ActiveIsa();
+
+	StringView GetIsaName(Isa isa);
+
+	/// @brief 1マイクロ秒で流れるピクセル数
+	/// @param scroll スクロール速度
+	inline double PixelsPerMicro(double scroll) {
+		return (Globals::defaultNoteSpeed * Globals::speed * scroll) / Timeline::MicrosPerSec;
+	}
+
+	/// @brief timing[i] + length[i] のノーツのY座標を out[i] に書き込む
+	/// @param timing ノーツの時間(マイクロ秒)
+	/// @param length timing に足す時間(マイクロ秒), 空なら足さない
+	/// @param t 現在時間(マイクロ秒)
+	/// @param pixelsPerMicro PixelsPerMicro(scroll)
+	/// @param out 出力先(timing.size() 以上)
+	/// @param isa 使う命令セット
+	/// @remark 判定ラインとの時間差が 2^51 マイクロ秒を超えると値が正しくない(実際の譜面では起きない)
+	void CalcY(std::span<const int64> timing, std::span<const int64> length, int64 t, double pixelsPerMicro, std::span<double> out, Isa isa = ActiveIsa());
+}
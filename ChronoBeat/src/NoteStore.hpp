@@ -0,0 +1,119 @@
+﻿#pragma once
+#include <numeric>
+
+#include "NoteType.hpp"
+
+/// @brief ノーツを1つずつ確保せず、項目ごとの配列にまとめて持つ
+/// @remark 毎フレームの判定・描画では timing と lane しか見ないノーツがほとんどなので、
+/// 項目ごとに詰めておくことでキャッシュに収まるようにしている
+struct NoteStore {
+	/// @brief state のビット
+	static constexpr uint8 Holding = 0b01;
+	static constexpr uint8 Removable = 0b10;
+
+	/// @brief 始点の時間(offsetを含むマイクロ秒)
+	Array<int64> timing;
+
+	/// @brief Holdの長さ(マイクロ秒), Hold以外は0
+	Array<int64> length;
+
+	Array<uint8> lane;
+	Array<NoteType> type;
+	Array<uint8> state;
+
+	size_t size() const noexcept {
+		return timing.size();
+	}
+
+	bool isEmpty() const noexcept {
+		return timing.isEmpty();
+	}
+
+	void reserve(size_t n) {
+		timing.reserve(n);
+		length.reserve(n);
+		lane.reserve(n);
+		type.reserve(n);
+		state.reserve(n);
+	}
+
+	void push_back(NoteType _type, uint8 _lane, int64 _timing, int64 _length = 0) {
+		timing << _timing;
+		length << _length;
+		lane << _lane;
+		type << _type;
+		state << uint8{ 0 };
+	}
+
+	bool isHolding(size_t i) const noexcept {
+		return (state[i] & Holding) != 0;
+	}
+
+	bool isRemovable(size_t i) const noexcept {
+		return (state[i] & Removable) != 0;
+	}
+
+	void setHolding(size_t i, bool value = true) noexcept {
+		state[i] = static_cast<uint8>(value ? (state[i] | Holding) : (state[i] & ~Holding));
+	}
+
+	void setRemovable(size_t i, bool value = true) noexcept {
+		state[i] = static_cast<uint8>(value ? (state[i] | Removable) : (state[i] & ~Removable));
+	}
+
+	/// @brief 条件を満たすノーツを、残りの順番を保ったまま取り除く
+	/// @param pred インデックスを受け取る述語
+	template <class Pred>
+	void removeIf(Pred pred) {
+		size_t kept = 0;
+
+		for (size_t i = 0; i < size(); ++i) {
+			if (pred(i)) continue;
+
+			if (kept != i) {
+				timing[kept] = timing[i];
+				length[kept] = length[i];
+				lane[kept] = lane[i];
+				type[kept] = type[i];
+				state[kept] = state[i];
+			}
+
+			++kept;
+		}
+
+		timing.resize(kept);
+		length.resize(kept);
+		lane.resize(kept);
+		type.resize(kept);
+		state.resize(kept);
+	}
+
+	/// @brief 判定済みのノーツを取り除く
+	void removeJudged() {
+		removeIf([this](size_t i) { return isRemovable(i); });
+	}
+
+	/// @brief 時間順に並べ直す(同時のノーツは元の順番のまま)
+	void sortByTiming() {
+		Array<size_t> order(size());
+		std::iota(order.begin(), order.end(), size_t{ 0 });
+
+		order.stable_sort_by([this](size_t a, size_t b) { return timing[a] < timing[b]; });
+
+		const auto gather = [&](auto& column) {
+			auto sorted = column;
+
+			for (size_t i = 0; i < order.size(); ++i) {
+				sorted[i] = column[order[i]];
+			}
+
+			column = std::move(sorted);
+		};
+
+		gather(timing);
+		gather(length);
+		gather(lane);
+		gather(type);
+		gather(state);
+	}
+};
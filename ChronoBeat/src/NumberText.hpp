@@ -0,0 +1,71 @@
+﻿#pragma once
+#include <Siv3D.hpp>
+
+/// @brief 0~9 の DrawableText を作っておき、並べて数字を描く
+/// @remark プレイ中に毎フレーム文字列を作らないためのもの。桁は等幅に並べる
+class NumberText {
+	Array<DrawableText> m_digits;
+
+	double m_digitWidth = 0.0;
+	double m_height = 0.0;
+
+	/// @brief 下の桁から順に buffer に入れる
+	/// @return 桁数
+	static size_t ToDigits(uint64 value, std::array<uint8, 20>& buffer) {
+		size_t count = 0;
+
+		do {
+			buffer[count++] = static_cast<uint8>(value % 10);
+			value /= 10;
+		} while (value != 0);
+
+		return count;
+	}
+
+public:
+	NumberText() = default;
+
+	explicit NumberText(const Font& font) {
+		for (char32 c = U'0'; c <= U'9'; ++c) {
+			m_digits << font(String(1, c));
+
+			const RectF region = m_digits.back().region();
+
+			m_digitWidth = Max(m_digitWidth, region.w);
+			m_height = Max(m_height, region.h);
+		}
+	}
+
+	/// @brief 中心を指定して描く
+	void drawAt(const TextStyle& style, uint64 value, const Vec2& center, const ColorF& color = Palette::White) const {
+		if (m_digits.isEmpty()) return;
+
+		std::array<uint8, 20> buffer;
+		const size_t count = ToDigits(value, buffer);
+
+		// 最上位の桁の中心
+		double x = center.x - m_digitWidth * (count - 1) / 2.0;
+
+		for (size_t i = count; 0 < i; --i) {
+			m_digits[buffer[i - 1]].drawAt(style, Vec2{ x, center.y }, color);
+			x += m_digitWidth;
+		}
+	}
+
+	/// @brief minDigits 桁分の枠に右揃えで描く
+	/// @param pos 枠の左上
+	void draw(uint64 value, const Vec2& pos, size_t minDigits, const ColorF& color = Palette::White) const {
+		if (m_digits.isEmpty()) return;
+
+		std::array<uint8, 20> buffer;
+		const size_t count = ToDigits(value, buffer);
+
+		// 最下位の桁の中心
+		double x = pos.x + m_digitWidth * (Max(count, minDigits) - 0.5);
+
+		for (size_t i = 0; i < count; ++i) {
+			m_digits[buffer[i]].drawAt(Vec2{ x, pos.y + m_height / 2.0 }, color);
+			x -= m_digitWidth;
+		}
+	}
+};
@@ -0,0 +1,76 @@
+﻿#pragma once
+
+/// @brief タップのずれ(ms)の集計
+/// @remark 外れ値は中央値からの距離が MAD(中央絶対偏差) の OutlierScale 倍を超えるものとして除く
+struct OffsetEstimate {
+	/// @brief 外れ値とみなす距離(MAD を標準偏差に直したものの何倍か)
+	static constexpr double OutlierScale = 3.0;
+
+	// 正規分布のとき MAD を標準偏差に直す係数
+	static constexpr double MadToSigma = 1.4826;
+
+	size_t count = 0;
+
+	/// @brief 外れ値を除いた数
+	size_t used = 0;
+
+	double mean = 0.0;
+	double stddev = 0.0;
+	double median = 0.0;
+
+	/// @brief 外れ値を除いた平均と標準偏差
+	double robustMean = 0.0;
+	double robustStddev = 0.0;
+
+	bool isValid() const noexcept {
+		return 0 < used;
+	}
+
+	static double Median(Array<double> values) {
+		if (values.isEmpty()) return 0.0;
+
+		values.sort();
+
+		const size_t half = values.size() / 2;
+
+		return (values.size() % 2) ? values[half] : (values[half - 1] + values[half]) / 2.0;
+	}
+
+	static std::pair<double, double> MeanAndStddev(const Array<double>& values) {
+		if (values.isEmpty()) return { 0.0, 0.0 };
+
+		const double mean = values.sum() / values.size();
+
+		double variance = 0.0;
+
+		for (const double value : values) {
+			variance += (value - mean) * (value - mean);
+		}
+
+		return { mean, Math::Sqrt(variance / values.size()) };
+	}
+
+	/// @param samples タップのずれ(ms, 正なら遅い)
+	static OffsetEstimate Calculate(const Array<double>& samples) {
+		OffsetEstimate result;
+
+		result.count = samples.size();
+
+		if (samples.isEmpty()) return result;
+
+		std::tie(result.mean, result.stddev) = MeanAndStddev(samples);
+		result.median = Median(samples);
+
+		const double mad = Median(samples.map([&](double value) { return Math::Abs(value - result.median); }));
+		const double limit = OutlierScale * MadToSigma * mad;
+
+		// ばらつきがない(MAD が0)ときは中央値と同じ値だけを残す
+		const Array<double> inliers = samples.filter([&](double value) { return Math::Abs(value - result.median) <= limit; });
+
+		result.used = inliers.size();
+
+		std::tie(result.robustMean, result.robustStddev) = MeanAndStddev(inliers);
+
+		return result;
+	}
+};
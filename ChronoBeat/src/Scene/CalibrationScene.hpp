@@ -0,0 +1,235 @@
+﻿#pragma once
+#include "Common.hpp"
+#include "../Globals.hpp"
+#include "../InputSampler.hpp"
+#include "../OffsetEstimate.hpp"
+
+/// @brief 音と表示の遅れの補正値を測る
+/// @remark 音だけ(メトロノーム)と表示だけ(判定ラインに落ちるノーツ)に合わせてタップしてもらい、
+/// それぞれのずれの平均を config.ini の Game.audio_offset / Game.visual_offset に保存する
+class CalibrationScene : public App::Scene {
+	enum class Phase {
+		Audio,
+		Visual,
+		Result
+	};
+
+	static constexpr double Bpm = 150.0;
+
+	/// @brief 1回の計測の拍数
+	static constexpr size_t BeatCount = 200;
+
+	/// @brief 最初の何拍は慣れるまでとして集計しない
+	static constexpr size_t LeadInBeats = 8;
+
+	/// @brief 計測の前後の待ち時間(マイクロ秒)
+	static constexpr int64 PhaseMergin = 2'000'000;
+
+	static constexpr int64 Interval = Timeline::FromSec(60.0 / Bpm);
+
+	Phase m_phase = Phase::Audio;
+
+	/// @brief 計測の0拍目の時刻(Time::GetMicrosec)
+	uint64 m_phaseStart = 0;
+
+	/// @brief 音の計測で、次に鳴らす拍と鳴らした時刻
+	size_t m_nextBeat = 0;
+	Array<uint64> m_clickTimes;
+
+	/// @brief 計測中に押した時刻
+	Array<uint64> m_taps;
+
+	OffsetEstimate m_audioEstimate;
+	OffsetEstimate m_visualEstimate;
+
+	// タップの時刻はフレームに丸めずに入力スレッドで記録する
+	InputSampler m_sampler{ Array<InputGroup>{ KeySpace | KeyD | KeyF | KeyJ | KeyK } };
+
+	RoundRect m_backButton{
+		Vec2{ 64, Globals::windowSize.y - 64 - 80 },
+		400, 80, 40
+	};
+
+	/// @brief 拍 beat の時刻
+	uint64 getBeatTime(size_t beat) const {
+		return m_phaseStart + static_cast<uint64>(beat * Interval);
+	}
+
+	/// @brief 計測を始める
+	void beginPhase(Phase phase) {
+		m_phase = phase;
+		m_phaseStart = Time::GetMicrosec() + PhaseMergin;
+		m_nextBeat = 0;
+		m_clickTimes.clear();
+		m_taps.clear();
+
+		// 前の計測中に押した分は捨てる
+		m_sampler.drain([](const KeyEvent&) {});
+	}
+
+	/// @brief タップを一番近い拍に合わせて、ずれ(ms)を集める
+	/// @param reference 拍ごとの基準の時刻
+	Array<double> collectErrors(const Array<uint64>& reference) const {
+		Array<double> errors;
+
+		for (const uint64 tap : m_taps) {
+			const int64 elapsed = static_cast<int64>(tap) - static_cast<int64>(m_phaseStart);
+			const int64 beat = (elapsed + Interval / 2) / Interval;
+
+			if (beat < static_cast<int64>(LeadInBeats) || static_cast<int64>(reference.size()) <= beat) continue;
+
+			const int64 error = static_cast<int64>(tap) - static_cast<int64>(reference[beat]);
+
+			// 半拍以上ずれたものは拍を取り違えている
+			if (Interval / 2 <= Math::Abs(error)) continue;
+
+			errors << error / 1000.0;
+		}
+
+		return errors;
+	}
+
+	void endPhase() {
+		if (m_phase == Phase::Audio) {
+			m_audioEstimate = OffsetEstimate::Calculate(collectErrors(m_clickTimes));
+
+			beginPhase(Phase::Visual);
+			return;
+		}
+
+		Array<uint64> beatTimes(BeatCount);
+
+		for (size_t beat = 0; beat < BeatCount; ++beat) {
+			beatTimes[beat] = getBeatTime(beat);
+		}
+
+		m_visualEstimate = OffsetEstimate::Calculate(collectErrors(beatTimes));
+
+		m_phase = Phase::Result;
+
+		Logger << U"Calibration audio: mean {:.2f}ms sd {:.2f}ms robust {:.2f}ms ({}/{})"_fmt(
+			m_audioEstimate.mean, m_audioEstimate.stddev, m_audioEstimate.robustMean, m_audioEstimate.used, m_audioEstimate.count);
+		Logger << U"Calibration visual: mean {:.2f}ms sd {:.2f}ms robust {:.2f}ms ({}/{})"_fmt(
+			m_visualEstimate.mean, m_visualEstimate.stddev, m_visualEstimate.robustMean, m_visualEstimate.used, m_visualEstimate.count);
+	}
+
+	void save() const {
+		if (m_audioEstimate.isValid()) Config.setValue(U"Game.audio_offset", m_audioEstimate.robustMean);
+		if (m_visualEstimate.isValid()) Config.setValue(U"Game.visual_offset", m_visualEstimate.robustMean);
+
+		Config.save();
+
+		Globals::Settings::reload();
+	}
+
+	void drawEstimate(StringView name, const OffsetEstimate& estimate, const Vec2& pos) const {
+		FontAsset(U"Font.UI.Normal")(name).draw(pos);
+
+		if (not estimate.isValid()) {
+			FontAsset(U"Font.UI.Normal")(U"no taps").draw(pos.movedBy(256, 0));
+			return;
+		}
+
+		FontAsset(U"Font.UI.Normal")(
+			U"{:+.1f} ms (mean {:+.1f}, median {:+.1f}, sd {:.1f}, {}/{} taps)"_fmt(
+				estimate.robustMean, estimate.mean, estimate.median, estimate.stddev, estimate.used, estimate.count)
+		).draw(pos.movedBy(256, 0));
+	}
+
+public:
+	CalibrationScene(const InitData& init) : IScene(init) {
+		m_clickTimes.reserve(BeatCount);
+		m_taps.reserve(BeatCount * 2);
+
+		beginPhase(Phase::Audio);
+	}
+
+	void update() override {
+		if (m_backButton.leftClicked() || KeyEscape.down()) {
+			changeScene(SceneState::Setting, Globals::sceneTransitionTime);
+			return;
+		}
+
+		if (m_phase == Phase::Result) {
+			if (KeyEnter.down()) {
+				save();
+				changeScene(SceneState::Setting, Globals::sceneTransitionTime);
+			}
+
+			return;
+		}
+
+		m_sampler.drain([&](const KeyEvent& event) {
+			if (event.pressed) m_taps << event.time;
+		});
+
+		const uint64 now = Time::GetMicrosec();
+
+		// 鳴らした時刻を基準にする(フレームの遅れの分も含めて測る)
+		if (m_phase == Phase::Audio && m_nextBeat < BeatCount && getBeatTime(m_nextBeat) <= now) {
+			AudioAsset(U"Audio.Game.Metronome").playOneShot(Globals::Settings::effectVolume);
+
+			m_clickTimes << now;
+			++m_nextBeat;
+		}
+
+		if (getBeatTime(BeatCount - 1) + Interval / 2 <= now) {
+			endPhase();
+		}
+	}
+
+	void draw() const override {
+		const Vec2 center = Scene::CenterF();
+
+		if (m_phase == Phase::Result) {
+			FontAsset(U"Font.UI.SubTitle")(U"Calibration").drawAt(center.movedBy(0, -240));
+
+			drawEstimate(U"Audio", m_audioEstimate, center.movedBy(-640, -80));
+			drawEstimate(U"Visual", m_visualEstimate, center.movedBy(-640, 0));
+
+			FontAsset(U"Font.UI.Normal")(U"Enter: save / Esc: discard").drawAt(center.movedBy(0, 200));
+		}
+		else {
+			const uint64 now = Time::GetMicrosec();
+			const int64 elapsed = static_cast<int64>(now) - static_cast<int64>(m_phaseStart);
+			const size_t beat = static_cast<size_t>(Clamp<int64>(elapsed / Interval + 1, 0, BeatCount));
+
+			FontAsset(U"Font.UI.SubTitle")(m_phase == Phase::Audio ? U"Tap to the click" : U"Tap when the note hits the line").drawAt(center.movedBy(0, -360));
+			FontAsset(U"Font.UI.Normal")(U"Space / D F J K    {} / {}"_fmt(beat, BeatCount)).drawAt(center.movedBy(0, -280));
+
+			if (m_phase == Phase::Visual) {
+				const RectF lane{ Arg::topCenter = Vec2{ center.x, 0 }, Globals::laneWidth, Globals::windowSize.y };
+
+				lane.draw(Palette::Black).drawFrame(1.0, Palette::White);
+
+				Line{ lane.x, Globals::judgeLineY, lane.x + lane.w, Globals::judgeLineY }.draw(2.0, Palette::Orange);
+
+				// 拍の時刻に判定ラインに届くノーツ
+				for (size_t i = 0; i < BeatCount; ++i) {
+					const double sec = Timeline::ToSec(static_cast<int64>(getBeatTime(i)) - static_cast<int64>(now));
+					const double y = Globals::judgeLineY - sec * Globals::defaultNoteSpeed * Globals::speed;
+
+					if (y < -Globals::noteHeight) break;
+					if (Globals::windowSize.y + Globals::noteHeight < y) continue;
+
+					RectF{ Arg::center = Vec2{ lane.centerX(), y }, lane.w - 8, Globals::noteHeight }.rounded(2).draw();
+				}
+			}
+		}
+
+		m_backButton.draw();
+		FontAsset(U"Font.UI.Normal")(U"Back").drawAt(m_backButton.center(), Palette::Black);
+	}
+
+	void drawFadeIn(double t) const override {
+		draw();
+
+		Common::drawFadeIn(t);
+	}
+
+	void drawFadeOut(double t) const override {
+		draw();
+
+		Common::drawFadeOut(t);
+	}
+};
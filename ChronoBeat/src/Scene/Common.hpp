@@ -6,6 +6,7 @@ enum class SceneState {
 	Title,
 	Select,
 	Setting,
+	Calibration,
 	Game,
 	Result
 };
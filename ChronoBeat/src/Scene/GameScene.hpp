@@ -3,6 +3,10 @@
 #include "../GameManager.hpp"
 
 #include "../SongInfo.hpp"
+#include "../LoadingCircle.hpp"
+#include "../NumberText.hpp"
+#include "../BeatmapWatcher.hpp"
+#include "../SongClock.hpp"
 
 class GameScene : public App::Scene {
 	GameManager m_game;
@@ -15,12 +19,26 @@ class GameScene : public App::Scene {
 	static constexpr Size JacketTileSize{ 350, 350 };
 	static constexpr int32 JudgeViewMargin = 64;
 
+	static constexpr SecondsF ReadyTime = 4.0s;
+	static constexpr double LoadingCircleRadius = 40.0;
+
 	SimpleAnimation m_playCount;
+	Stopwatch m_readyTimer{ StartImmediately::No };
+
+	// Ready? の間に裏で譜面を読み込む
+	AsyncTask<Beatmap> m_beatmapTask;
+	bool m_isLoaded = false;
+
+	// 譜面を読み込めず、選曲に戻る
+	bool m_isFailed = false;
 
-	double m_metronomeMergin;
+	// --hot-reload のときだけ有効
+	Optional<BeatmapWatcher> m_beatmapWatcher;
 
-	Stopwatch m_metronomeTimer{ StartImmediately::No };
-	Stopwatch m_songTimer{ StartImmediately::No };
+	double m_metronomeMergin = 0.0;
+
+	/// @brief 譜面上の時間(カウントの間はタイマー、再生中は曲の再生位置に合わせる)
+	SongClock m_clock;
 
 	bool m_isPlayed = false;
 
@@ -28,6 +46,10 @@ class GameScene : public App::Scene {
 
 	double m_gameSpeed = 1.0;
 
+	// 判定数の表示に使う文字(毎フレーム文字列を作らない)
+	HashTable<JudgeType, DrawableText> m_judgeNameTexts;
+	NumberText m_judgeCountText{ FontAsset(U"Font.Game.Judge.1") };
+
 	bool m_isAutomode = false;
 
 public:
@@ -41,23 +63,90 @@ public:
 
 		m_jacketImage = TextureAsset(m_info.getJacketAssetName());
 
+		for (const JudgeType type : { JudgeType::Perfect, JudgeType::Great, JudgeType::Near, JudgeType::Miss }) {
+			m_judgeNameTexts.emplace(type, FontAsset(U"Font.Game.Judge.1")(GetJudgeName(type)));
+		}
+
 		const BeatmapInfo& beatmapInfo = m_info.beatmapInfos[getData().currentDifficulty];
-		const Beatmap& beatmap{ beatmapInfo.jsonPath, m_song.lengthSec() };
 
-		m_metronomeMergin = 60.0 / beatmap.bpm / m_gameSpeed;
+		// 曲の長さは起動時に調べたものを使い、曲のデコードを待たずに譜面を読み込む
+		const double length = m_info.songLengthSec;
+
+		// 保存を反映するときは、差分を当てられるようにJSONから直接ノーツを作る
+		if (Globals::isHotReloadEnabled && FileSystem::Exists(beatmapInfo.jsonPath)) {
+			m_beatmapWatcher.emplace(beatmapInfo.jsonPath);
 
-		m_game = GameManager{ beatmap };
+			m_beatmapTask = Async([path = beatmapInfo.jsonPath, length] {
+				return Beatmap{ path, length };
+			});
+		}
+		else {
+			m_beatmapTask = Async([path = beatmapInfo.jsonPath, length] {
+				return Beatmap::Load(path, length);
+			});
+		}
 
+		// フェードアウトは譜面の BPM が分かってから追加する
 		m_playCount
 			.set(U"Ready", { 0.0s, 0.0 }, { 1.0s, 1.0 }, EaseOutCubic)
-			.set(U"Ready", { 4.0s, 1.0 }, { 4.0s + SecondsF{ m_metronomeMergin }, 0.0 }, EaseInCubic)
 			.start();
 
+		m_readyTimer.start();
+
 		//System::SetTerminationTriggers(UserAction::NoAction);
 	}
 
 	~GameScene() {
 		System::SetTerminationTriggers(UserAction::Default);
+
+		if (LoadingCircleAddon::IsActive()) LoadingCircleAddon::End();
+	}
+
+	/// @brief 譜面の読み込みが終わっていればゲームを準備する
+	/// @return 準備ができていれば true
+	bool pollBeatmap() {
+		if (m_isLoaded) return true;
+		if (m_isFailed) return false;
+
+		if (not m_beatmapTask.isReady()) {
+			// カウントダウンが終わっても読み込み中ならロード表示
+			if (ReadyTime <= m_readyTimer.elapsed() && not LoadingCircleAddon::IsActive()) {
+				const Vec2 pos = Globals::windowSize.movedBy(-LoadingCircleRadius - 16, -LoadingCircleRadius - 16);
+				LoadingCircleAddon::Begin(Circle{ pos, LoadingCircleRadius }, 2.0, Palette::White);
+			}
+
+			return false;
+		}
+
+		if (LoadingCircleAddon::IsActive()) LoadingCircleAddon::End();
+
+		Beatmap beatmap;
+
+		// 読めない譜面や対応していないレーン数の譜面は遊ばずに選曲に戻る
+		try {
+			beatmap = m_beatmapTask.get();
+
+			m_game = GameManager{ beatmap };
+		}
+		catch (const Error& error) {
+			Logger << U"Failed to load beatmap: {}"_fmt(error.what());
+
+			m_isFailed = true;
+
+			changeScene(SceneState::Select, Globals::sceneTransitionTime);
+
+			return false;
+		}
+
+		m_metronomeMergin = 60.0 / beatmap.bpm / m_gameSpeed;
+
+		const SecondsF readyEnd = Max(ReadyTime, SecondsF{ m_readyTimer.sF() });
+
+		m_playCount.set(U"Ready", { readyEnd, 1.0 }, { readyEnd + SecondsF{ m_metronomeMergin }, 0.0 }, EaseInCubic);
+
+		m_isLoaded = true;
+
+		return true;
 	}
 
 	void update() override {
@@ -65,12 +154,15 @@ public:
 		if (SimpleGUI::CheckBox(m_isAutomode, U"Auto", { 10, 10 }));
 		if (SimpleGUI::Slider(U"speed", m_gameSpeed, 0.25, 10.0, Vec2{ 10, 60 }, 80, 120, m_isPlayed)) {
 			m_song.setSpeed(m_gameSpeed);
+			m_clock.setSpeed(m_gameSpeed);
 		}
 #endif
 
+		if (not pollBeatmap()) return;
 		if (not m_playCount.isDone()) return;
-		if (not m_metronomeTimer.isStarted()) m_metronomeTimer.start();
-		if (not m_songTimer.isStarted()) m_songTimer.start();
+
+		// カウント(1拍目が譜面の0)から始める
+		if (not m_clock.isStarted()) m_clock.start(-Timeline::FromSec(m_metronomeMergin));
 
 		if (isFinished()) {
 			auto& data = getData();
@@ -82,7 +174,13 @@ public:
 			changeScene(SceneState::Result, Globals::sceneTransitionTime);
 		}
 
-		const double now = m_songTimer.sF();
+		const uint64 clock = Time::GetMicrosec();
+
+		if (m_isPlayed) {
+			m_clock.sync(getAudioTime(), clock);
+		}
+
+		const int64 t = m_clock.now(clock);
 
 		if (4 < m_metronomeCount) {
 			if (not m_isPlayed) {
@@ -90,20 +188,22 @@ public:
 				m_isPlayed = true;
 			}
 		}
-		else if (const double currentTimer = m_metronomeTimer.sF(); m_metronomeMergin <= currentTimer) {
+		else if (static_cast<int64>(m_metronomeCount) * Timeline::FromSec(m_metronomeMergin) <= t) {
 			AudioAsset(U"Audio.Game.Metronome").playOneShot(Globals::Settings::effectVolume);
 			m_metronomeCount += 1;
+		}
 
-			m_metronomeTimer.set(SecondsF{ currentTimer - m_metronomeMergin });
+		// 曲の位置はそのままで、変わったノーツだけ差し替える
+		if (m_beatmapWatcher) {
+			if (const auto patch = m_beatmapWatcher->update()) {
+				m_game.applyPatch(*patch, t);
+			}
 		}
 
-		m_game.update(Min(now - m_metronomeMergin, m_metronomeMergin * 4) + m_song.posSec(), m_isAutomode);
+		m_game.update(t, clock, m_isAutomode);
 	}
 
 	void draw() const override {
-		const double now = m_songTimer.sF();
-		const double ratio = now / m_song.lengthSec();
-
 		// ジャケット
 		{
 			const RectF jacketRegion{
@@ -127,20 +227,26 @@ public:
 
 				for (auto&& [key, value] : m_game.getJudges()) {
 					const Color& color = Globals::judgeColor[key];
-					FontAsset(U"Font.Game.Judge.1")(GetJudgeName(key))
+					m_judgeNameTexts.at(key)
 						.draw(
 							TextStyle::Outline(0.1, Palette::White),
 							pos.moveBy(0, JudgeViewMargin), color
 						);
-					FontAsset(U"Font.Game.Judge.1")(U"{:4d}"_fmt(value)).draw(pos.movedBy(160, 0));
+					m_judgeCountText.draw(value, pos.movedBy(160, 0), 4);
 				}
 			}
 		}
 
-		m_game.draw(Min(now - m_metronomeMergin, m_metronomeMergin * 4) + m_song.posSec());
+		if (m_isLoaded) {
+			m_game.draw(getSongTime());
+		}
+		else {
+			m_game.drawLane();
+			m_game.drawJudgeLine();
+		}
 
 		// Ready?
-		if (not m_playCount.isDone()) {
+		if (not m_isLoaded || not m_playCount.isDone()) {
 			const Vec2 scenter = Scene::CenterF();
 			const RectF region = FontAsset(U"Font.UI.Title")(U"Ready?").regionAt(scenter);
 
@@ -156,6 +262,22 @@ public:
 		}
 	}
 
+	/// @brief 譜面上の現在時間(マイクロ秒)
+	int64 getSongTime() const {
+		// カウントが始まるまでは1拍目の1拍前で止めておく
+		if (not m_clock.isStarted()) return -Timeline::FromSec(m_metronomeMergin);
+
+		return m_clock.now();
+	}
+
+	/// @brief 曲の再生位置(サンプル数)から求めた譜面上の時間(マイクロ秒)
+	/// @remark 曲はカウント4拍分のあとに始まる
+	int64 getAudioTime() const {
+		const int64 mergin = Timeline::FromSec(m_metronomeMergin);
+
+		return mergin * 4 + (m_song.posSample() * Timeline::MicrosPerSec / m_song.sampleRate());
+	}
+
 	bool isFinished() const {
 		return m_isPlayed && not m_song.isActive();
 	}
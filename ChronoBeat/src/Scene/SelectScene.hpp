@@ -3,6 +3,7 @@
 #include "../Globals.hpp"
 #include "../SongInfo.hpp"
 #include "../CrawlingText.hpp"
+#include "../JacketAtlas.hpp"
 
 class SelectScene : public App::Scene {
 	// 3:4
@@ -46,6 +47,22 @@ class SelectScene : public App::Scene {
 
 	Audio m_song;
 
+	// 画面付近のタイルのジャケットだけを縮小して保持する
+	JacketAtlas m_jackets{ JacketTileSize };
+
+	/// @brief i番目のタイルの中心
+	Vec2 getTileCenter(size_t i) const {
+		return TileBaseCenter.movedBy(m_tileOffsetX + (TileMarginX / 2) + (i * (TileSize.x + TileMarginX)), 0);
+	}
+
+	/// @brief タイルが画面の近く(両端から1枚分以内)にあるか
+	bool isNearViewport(size_t i) const {
+		const double x = getTileCenter(i).x;
+		const double margin = TileSize.x * 1.5 + TileMarginX;
+
+		return (-margin <= x && x <= Globals::windowSize.x + margin);
+	}
+
 public:
 	SelectScene(const InitData& init) : IScene(init) {
 
@@ -94,10 +111,8 @@ public:
 
 		// クリックされた曲を選択
 		for (auto&& [i, info] : Indexed(m_infos)) {
-			const Vec2 center = TileBaseCenter.movedBy(m_tileOffsetX + (TileMarginX / 2) + (i * (TileSize.x + TileMarginX)), 0);
-
 			// タイル
-			RectF region{ Arg::center = center, TileSize };
+			RectF region{ Arg::center = getTileCenter(i), TileSize };
 
 			if (region.leftClicked()) {
 				if (m_selectInfoIndex == static_cast<int32>(i)) transition();
@@ -108,6 +123,13 @@ public:
 		double targetTileOffset = -m_selectInfoIndex * (TileSize.x + TileMarginX);
 		m_tileOffsetX = Math::SmoothDamp(m_tileOffsetX, targetTileOffset, m_tileOffsetVelocityX, 0.1);
 
+		// ジャケットの読み込み
+		for (auto&& [i, info] : Indexed(m_infos)) {
+			if (isNearViewport(i)) m_jackets.request(i, info.jacketPath);
+		}
+
+		m_jackets.update();
+
 		// 曲セレクト
 		// (曲選択時、ビジュアル的に選択されるまでは反応しないように)
 		if(Math::Abs(m_tileOffsetX - targetTileOffset) <= m_selectableTileWidth){
@@ -120,6 +142,12 @@ public:
 		if (m_beforeIndex != m_selectInfoIndex) {
 			if (m_song.isPlaying()) m_song.stop();
 
+			// プレビューし終わった曲は解放して、保持する曲データを1曲分に抑える
+			if (0 <= m_beforeIndex && m_beforeIndex < static_cast<int32>(m_infos.size())) {
+				m_song = Audio{};
+				m_infos[m_beforeIndex].releaseSong();
+			}
+
 			AudioAsset(U"Audio.UI.MoveCursor").playOneShot(Globals::Settings::effectVolume);
 
 			m_song = AudioAsset(m_infos[m_selectInfoIndex].getSongAssetName());
@@ -154,11 +182,23 @@ public:
 		m_songSubFont(U"{:4d} / {:2d}"_fmt(m_selectInfoIndex + 1, m_infos.size()))
 			.drawAt(TileBaseCenter.movedBy(0, TileSize.y / 2).movedBy(0, m_songSubFont.height() * 1.5));
 
+		// ジャケット(すべて同じテクスチャなので、間に他の描画を挟まずまとめて描く)
 		for (auto&& [i, info] : Indexed(m_infos)) {
-			const Vec2 center = TileBaseCenter.movedBy(m_tileOffsetX + (TileMarginX / 2) + (i * (TileSize.x + TileMarginX)), 0);
+			if (not isNearViewport(i)) continue;
+
+			const RectF region{ Arg::center = getTileCenter(i), TileSize };
+			const Vec2 jacketCenter = region.pos + JacketTileOffset + JacketTileSize / 2;
+
+			if (const auto jacket = m_jackets.get(i)) {
+				jacket->drawAt(jacketCenter);
+			}
+		}
+
+		for (auto&& [i, info] : Indexed(m_infos)) {
+			if (not isNearViewport(i)) continue;
 
 			// タイル
-			RectF region{ Arg::center = center, TileSize };
+			RectF region{ Arg::center = getTileCenter(i), TileSize };
 
 			// 枠線
 			region.drawFrame(
@@ -167,16 +207,11 @@ public:
 				currentDifficultyColor.withAlpha(.0)
 			);
 
-			// ジャケット
-			const Texture& jacket = TextureAsset(info.getJacketAssetName());
-			const Size& jacketSize = jacket.size();
-
+			// ジャケットの枠
 			const Vec2 jacketCenter = region.pos + JacketTileOffset + JacketTileSize / 2;
-			const RectF jacketRegion = jacket.resized(
-				Math::Max(JacketTileSize.x, jacketSize.x * static_cast<double>(JacketTileSize.y) / jacketSize.y),
-				Math::Max(JacketTileSize.y, jacketSize.y * static_cast<double>(JacketTileSize.x) / jacketSize.x)
-			).drawAtClipped(jacketCenter, RectF{ Arg::center = jacketCenter, JacketTileSize })
-			.drawFrame(2, Palette::White);
+			const RectF jacketRegion{ Arg::center = jacketCenter, JacketTileSize };
+
+			jacketRegion.drawFrame(2, Palette::White);
 
 			// タイトル
 			const double songTitleFontHeight = m_songTitleFont.height();
@@ -149,6 +149,11 @@ struct SettingScene : public App::Scene {
 		NumberUI::UIWidth, NumberUI::UIHeight, NumberUI::UIHeight / 2
 	};
 
+	RoundRect calibrationButton{
+		Vec2{ UIStartPos.x / 2 + NumberUI::UIWidth + NumberUI::ButtonMergin, Globals::windowSize.y - UIStartPos.y / 2 - NumberUI::UIHeight },
+		NumberUI::UIWidth, NumberUI::UIHeight, NumberUI::UIHeight / 2
+	};
+
 	Audio bgm = AudioAsset(U"Audio.UI.BGM");
 
 public:
@@ -183,6 +188,10 @@ public:
 			changeScene(SceneState::Select, Globals::sceneTransitionTime);
 		}
 
+		if (calibrationButton.leftClicked()) {
+			changeScene(SceneState::Calibration, Globals::sceneTransitionTime);
+		}
+
 		if (Globals::windowSize.y < (noteTimer.sF() * Globals::defaultNoteSpeed * Globals::speed)) {
 			if (not merginTimer.isRunning()) merginTimer.start();
 		}
@@ -235,6 +244,12 @@ public:
 		backButton.draw();
 		FontAsset(U"Font.UI.Normal")(U"Back").drawAt(backButton.center(), Palette::Black);
 
+		calibrationButton.draw();
+		FontAsset(U"Font.UI.Normal")(U"Calibrate").drawAt(calibrationButton.center(), Palette::Black);
+
+		FontAsset(U"Font.UI.Detail")(U"audio {:+.1f}ms / visual {:+.1f}ms"_fmt(Globals::Settings::audioOffset, Globals::Settings::visualOffset))
+			.draw(Arg::topCenter = calibrationButton.bottomCenter().movedBy(0, 8));
+
 		{
 			Rect lane{ Globals::windowSize.x - Globals::laneWidth - 256, 0, Globals::laneWidth, Globals::windowSize.y };
 
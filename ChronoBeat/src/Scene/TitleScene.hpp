@@ -22,6 +22,8 @@ struct TitleScene : public App::Scene {
 
 	bool m_animationFinished = false;
 
+	bool m_transitionRequested = false;
+
 public:
 	TitleScene(const InitData& init) : IScene(init) {
 		System::SetTerminationTriggers(UserAction::Default);
@@ -45,7 +47,12 @@ public:
 		});
 
 		// アニメーションが終わっていてアクションがあれば遷移
+		// (曲の読み込みが終わっていなければ終わるまで待つ)
 		if (m_animationFinished && actioned) {
+			m_transitionRequested = true;
+		}
+
+		if (m_transitionRequested && Globals::isSongLibraryLoaded) {
 			m_titleBGM.stop();
 			changeScene(SceneState::Select, Globals::sceneTransitionTime);
 		}
@@ -0,0 +1,129 @@
+﻿#pragma once
+#include "Timeline.hpp"
+
+/// @brief 曲の再生位置と高精度タイマーから求める譜面上の時間
+/// @remark 曲の再生位置はオーディオのバッファ単位でしか進まないため、そのまま使うとノーツのスクロールがカクつく。
+/// 時間はタイマー(Time::GetMicrosec)で進め、再生位置とのずれは進む速さを少しずつ変えて直す。
+/// 返す時間は戻らない(再生が止まったときは進まずに待つ)
+class SongClock {
+public:
+	/// @brief これ以上ずれたら速さで直さずに合わせ直す(マイクロ秒)
+	static constexpr int64 ResyncThreshold = 50'000;
+
+	/// @brief ずれをどれくらいの時間をかけて直すか(マイクロ秒)
+	static constexpr double CorrectionWindow = 250'000.0;
+
+	/// @brief ずれの平滑化の係数(0~1, 小さいほど滑らか)
+	static constexpr double ErrorSmoothing = 0.2;
+
+	/// @brief タイマーと再生位置の進み方の違い(ドリフト)を学習する係数
+	static constexpr double DriftGain = 1e-8;
+
+	/// @brief 速さを変える上限(割合)
+	static constexpr double MaxRateAdjustment = 0.05;
+	static constexpr double MaxDrift = 0.01;
+
+private:
+	/// @brief 基準にした譜面上の時間と、そのときの時刻
+	int64 m_anchorTime = 0;
+	uint64 m_anchorClock = 0;
+
+	/// @brief 譜面上の時間の進む速さ(実時間1に対して)
+	double m_rate = 1.0;
+
+	/// @brief 曲の再生速度
+	double m_speed = 1.0;
+
+	/// @brief 学習したドリフト(割合)
+	double m_drift = 0.0;
+
+	/// @brief 平滑化したずれ(マイクロ秒)
+	double m_error = 0.0;
+
+	/// @brief 最後に受け取った再生位置(変わっていなければ合わせない)
+	Optional<int64> m_lastAudioTime;
+
+	bool m_isStarted = false;
+
+	/// @brief 基準を clock の時点の時間に置き直す(時間は連続のまま)
+	void reanchor(uint64 clock) {
+		m_anchorTime = now(clock);
+		m_anchorClock = clock;
+	}
+
+public:
+	/// @brief タイマーで時間を進め始める
+	/// @param time 始める譜面上の時間(マイクロ秒)
+	/// @param clock 始める時刻(Time::GetMicrosec)
+	void start(int64 time, uint64 clock = Time::GetMicrosec()) {
+		m_anchorTime = time;
+		m_anchorClock = clock;
+		m_rate = m_speed;
+		m_drift = 0.0;
+		m_error = 0.0;
+		m_lastAudioTime.reset();
+		m_isStarted = true;
+	}
+
+	bool isStarted() const noexcept {
+		return m_isStarted;
+	}
+
+	/// @brief 曲の再生速度を変える
+	void setSpeed(double speed, uint64 clock = Time::GetMicrosec()) {
+		if (m_isStarted) reanchor(clock);
+
+		m_speed = speed;
+		m_rate = speed;
+	}
+
+	/// @brief 曲の再生位置に合わせる(毎フレーム呼ぶ)
+	/// @param audioTime 再生位置から求めた譜面上の時間(マイクロ秒)
+	/// @param clock 再生位置を読んだ時刻(Time::GetMicrosec)
+	void sync(int64 audioTime, uint64 clock = Time::GetMicrosec()) {
+		if (not m_isStarted) start(audioTime, clock);
+
+		// 再生位置はバッファ単位で進むので、変わった直後だけを使う
+		if (m_lastAudioTime == audioTime) return;
+
+		m_lastAudioTime = audioTime;
+
+		reanchor(clock);
+
+		const int64 error = audioTime - m_anchorTime;
+
+		if (ResyncThreshold < error) {
+			// 再生位置の方がずっと進んでいる: 飛ばして合わせる
+			m_anchorTime = audioTime;
+			m_error = 0.0;
+			m_rate = m_speed * (1.0 + m_drift);
+			return;
+		}
+
+		if (error < -ResyncThreshold) {
+			// 再生が止まっている: 戻さずに追いつくまで待つ
+			m_error = 0.0;
+			m_rate = 0.0;
+			return;
+		}
+
+		m_error += (error - m_error) * ErrorSmoothing;
+		m_drift = Clamp(m_drift + m_error * DriftGain, -MaxDrift, MaxDrift);
+
+		const double adjustment = Clamp(m_drift + m_error / CorrectionWindow, -MaxRateAdjustment, MaxRateAdjustment);
+
+		m_rate = m_speed * (1.0 + adjustment);
+	}
+
+	/// @brief 譜面上の時間
+	/// @param clock 時刻(Time::GetMicrosec)
+	/// @return 譜面上の時間(マイクロ秒), 始める前は0
+	int64 now(uint64 clock = Time::GetMicrosec()) const {
+		if (not m_isStarted) return 0;
+
+		// 基準より前の時刻は基準の時間にする(戻さない)
+		const int64 elapsed = (m_anchorClock < clock) ? static_cast<int64>(clock - m_anchorClock) : 0;
+
+		return m_anchorTime + static_cast<int64>(elapsed * m_rate);
+	}
+};
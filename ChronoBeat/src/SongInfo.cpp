@@ -1,14 +1,34 @@
 ﻿#include "SongInfo.hpp"
 #include "Globals.hpp"
+#include "SongLibrary.hpp"
 
 SongInfo::SongInfo(const JSON& json) {
-	FilePath base = FileSystem::PathAppend(Globals::BeatmapBaseDir, json[U"name"].getString());
-
 	title = json[U"title"].getString();
 	artist = json[U"artist"].getString();
 
 	bpm = json[U"bpm"].getString();
 
+	Array<double> beatmapDifficulties{ };
+
+	for (const JSON& e : json[U"difficulties"].arrayView()) {
+		beatmapDifficulties << e.get<double>();
+	}
+
+	setPaths(json[U"name"].getString(), beatmapDifficulties);
+}
+
+SongInfo::SongInfo(const SongRecord& record) {
+	title = record.title;
+	artist = record.artist;
+
+	bpm = record.bpm;
+
+	setPaths(record.id, Array<double>(record.difficulties.begin(), record.difficulties.end()));
+}
+
+void SongInfo::setPaths(const String& name, const Array<double>& beatmapDifficulties) {
+	FilePath base = FileSystem::PathAppend(Globals::BeatmapBaseDir, name);
+
 	jacketPath = FileSystem::PathAppend(base, U"jacket.png");
 	songPath = FileSystem::PathAppend(base, U"song.wav");
 
@@ -18,11 +38,6 @@ SongInfo::SongInfo(const JSON& json) {
 		U"hard.json",
 		U"chronos.json"
 	};
-	Array<double> beatmapDifficulties{ };
-
-	for (const JSON& e : json[U"difficulties"].arrayView()) {
-		beatmapDifficulties << e.get<double>();
-	}
 
 	for (int32 i : step(static_cast<int32>(SongDifficulty::Chronos) + 1)) {
 		beatmapInfos[static_cast<SongDifficulty>(i)] = BeatmapInfo{
@@ -36,15 +51,27 @@ SongInfo SongInfo::registerAsset() const {
 	const String& songName = getSongAssetName();
 	const String& textureName = getJacketAssetName();
 
-	if (not AudioAsset::Register(songName, Resource(songPath))) throw AssetRegistError{ songName };
-	if (not TextureAsset::Register(textureName, Resource(jacketPath))) throw AssetRegistError{ textureName };
+	// 曲は登録だけして起動時にはデコードしない
+	// ディスク上のファイルはストリーミング再生、埋め込みリソースは初回使用時に読み込む
+	const FilePath songFile = Resource(songPath);
 
-	AudioAsset::Load(songName);
-	TextureAsset::Load(textureName);
+	if (FileSystem::IsResource(songFile)) {
+		if (not AudioAsset::Register(songName, songFile)) throw AssetRegistError{ songName };
+	}
+	else {
+		if (not AudioAsset::Register(songName, Audio::Stream, songFile)) throw AssetRegistError{ songName };
+	}
+
+	// ジャケットは選曲画面では JacketAtlas で縮小したものを使うので、ここでは読み込まない
+	if (not TextureAsset::Register(textureName, Resource(jacketPath))) throw AssetRegistError{ textureName };
 
 	return *this;
 }
 
+void SongInfo::releaseSong() const {
+	AudioAsset::Release(getSongAssetName());
+}
+
 inline String SongInfo::getJacketAssetName() const {
 	return U"Jacket.{}"_fmt(title);
 }
@@ -16,6 +16,8 @@ struct BeatmapInfo {
 		difficulty{ _difficulty } { }
 };
 
+struct SongRecord;
+
 struct SongInfo {
 	static constexpr ColorF EasyColor = Palette::Lime;
 	static constexpr ColorF NormalColor = Palette::Yellow;
@@ -29,14 +31,22 @@ struct SongInfo {
 	FilePath jacketPath = U"";
 	FilePath songPath = U"";
 
+	// 起動時に曲のヘッダから読み取った長さ(秒), 譜面の長さに使う
+	double songLengthSec = 0.0;
+
 	HashTable<SongDifficulty, BeatmapInfo> beatmapInfos;
 
 	SongInfo(){}
 
 	SongInfo(const JSON&);
 
+	SongInfo(const SongRecord&);
+
 	SongInfo registerAsset() const;
 
+	/// @brief 曲のデコード済みデータ・ストリームを解放する(登録は残る)
+	void releaseSong() const;
+
 	inline String getJacketAssetName() const;
 
 	inline String getSongAssetName() const;
@@ -55,6 +65,9 @@ struct SongInfo {
 		return U"Chronos";
 	}
 
+	/// @brief 曲フォルダ名から各ファイルのパスを設定する
+	void setPaths(const String& name, const Array<double>& beatmapDifficulties);
+
 	friend void Formatter(FormatData& format, const SongInfo& info) {
 		format.string += U"{}<{}>: {}"_fmt(info.title, info.artist, info.bpm);
 	}
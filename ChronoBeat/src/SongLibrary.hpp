@@ -0,0 +1,442 @@
+﻿#pragma once
+#include <numeric>
+
+#include <Siv3D.hpp>
+
+/// @brief 曲ライブラリの1曲分の情報
+struct SongRecord {
+	/// @brief 曲のフォルダ名 (songinfo.json の "name")
+	String id;
+
+	String title;
+	String artist;
+	String bpm;
+
+	std::array<double, 4> difficulties{};
+
+	/// @brief info.json の更新時刻 (songinfo.json から取り込んだものは既定値)
+	DateTime modified{};
+
+	/// @brief 削除された曲か(追記型のインデックスで古い記録を打ち消すのに使う)
+	bool removed = false;
+
+	friend bool operator==(const SongRecord&, const SongRecord&) = default;
+};
+
+/// @brief 曲ライブラリのインデックス
+/// @remark songinfo.json と曲ごとの beatmap/<id>/info.json を元に songlibrary.idx に追記していき、
+/// 変更があった曲の記録だけを書き足す。検索は id・タイトルとも O(log n)
+class SongLibrary {
+	static constexpr std::array<char, 4> Magic{ 'C', 'B', 'S', 'L' };
+
+	// 2: ヘッダに songinfo.json のハッシュを持つ
+	static constexpr uint32 Version = 2;
+
+	/// @brief 無効になった記録がこの割合を超えたら書き直す
+	static constexpr double CompactionRatio = 0.5;
+
+	FilePath m_indexPath;
+
+	Array<SongRecord> m_records;
+
+	// m_records へのインデックスを id 順・タイトル順に並べたもの
+	Array<uint32> m_byId;
+	Array<uint32> m_byTitle;
+
+	// インデックスファイル中の記録の数(上書きされたものも含む)
+	size_t m_loggedCount = 0;
+
+	// インデックスファイルが途中で壊れている(書き直すまで追記しない)
+	bool m_isDamaged = false;
+
+	// 最後に取り込んだ songinfo.json の内容のハッシュ(MD5)
+	String m_legacyHash;
+
+	static void WriteHeader(BinaryWriter& writer, const String& legacyHash) {
+		writer.write(Magic);
+		writer.write(Version);
+
+		WriteString(writer, legacyHash);
+	}
+
+	static void WriteString(BinaryWriter& writer, const String& str) {
+		const std::string utf8 = str.toUTF8();
+
+		writer.write(static_cast<uint32>(utf8.size()));
+		writer.write(utf8.data(), static_cast<int64>(utf8.size()));
+	}
+
+	static Optional<String> ReadString(BinaryReader& reader) {
+		uint32 size = 0;
+
+		if (not reader.read(size)) return none;
+		if (reader.size() - reader.getPos() < size) return none;
+
+		std::string utf8(size, '\0');
+
+		if (reader.read(utf8.data(), size) != size) return none;
+
+		return Unicode::FromUTF8(utf8);
+	}
+
+	static void WriteRecord(BinaryWriter& writer, const SongRecord& record) {
+		writer.write(static_cast<uint8>(record.removed));
+		writer.write(record.modified);
+		writer.write(record.difficulties);
+
+		WriteString(writer, record.id);
+		WriteString(writer, record.title);
+		WriteString(writer, record.artist);
+		WriteString(writer, record.bpm);
+	}
+
+	static Optional<SongRecord> ReadRecord(BinaryReader& reader) {
+		SongRecord record;
+		uint8 removed = 0;
+
+		if (not (reader.read(removed) && reader.read(record.modified) && reader.read(record.difficulties))) return none;
+
+		record.removed = (removed != 0);
+
+		for (String* str : { &record.id, &record.title, &record.artist, &record.bpm }) {
+			if (auto value = ReadString(reader)) {
+				*str = std::move(*value);
+			}
+			else {
+				return none;
+			}
+		}
+
+		return record;
+	}
+
+	/// @brief インデックスファイルを先頭から1件ずつ読み、同じ id は後の記録で上書きする
+	/// @remark 書き込み中に落ちるなどして途中から読めないときは、読めた記録までを使い m_isDamaged にする
+	void load() {
+		BinaryReader reader{ m_indexPath };
+
+		if (not reader) return;
+
+		std::array<char, 4> magic{};
+		uint32 version = 0;
+
+		if (not (reader.read(magic) && reader.read(version)) || magic != Magic || version != Version) {
+			m_isDamaged = true;
+			return;
+		}
+
+		if (auto legacyHash = ReadString(reader)) {
+			m_legacyHash = std::move(*legacyHash);
+		}
+		else {
+			m_isDamaged = true;
+			return;
+		}
+
+		HashTable<String, size_t> positions;
+
+		// 最後に読めた記録の終わり
+		int64 validEnd = reader.getPos();
+
+		while (auto record = ReadRecord(reader)) {
+			++m_loggedCount;
+			validEnd = reader.getPos();
+
+			if (auto it = positions.find(record->id); it != positions.end()) {
+				m_records[it->second] = std::move(*record);
+			}
+			else {
+				positions.emplace(record->id, m_records.size());
+				m_records << std::move(*record);
+			}
+		}
+
+		if (validEnd < reader.size()) {
+			Logger << U"SongLibrary: {} is broken at offset {} ({} bytes)"_fmt(m_indexPath, validEnd, reader.size());
+			m_isDamaged = true;
+		}
+
+		m_records.remove_if([](const SongRecord& r) { return r.removed; });
+
+		rebuildIndices();
+	}
+
+	void rebuildIndices() {
+		m_byId.resize(m_records.size());
+		std::iota(m_byId.begin(), m_byId.end(), 0u);
+		m_byTitle = m_byId;
+
+		m_byId.sort_by([&](uint32 a, uint32 b) { return m_records[a].id < m_records[b].id; });
+		m_byTitle.sort_by([&](uint32 a, uint32 b) { return m_records[a].title < m_records[b].title; });
+	}
+
+	/// @brief 記録をインデックスファイルの末尾に追記する
+	void append(const SongRecord& record) {
+		// 壊れた記録の後ろに書いても読めないので、書き直せるまでは追記しない
+		if (m_isDamaged) return;
+
+		const bool exists = FileSystem::Exists(m_indexPath);
+
+		BinaryWriter writer{ m_indexPath, OpenMode::Append };
+
+		if (not writer) return;
+
+		if (not exists) {
+			WriteHeader(writer, m_legacyHash);
+		}
+
+		WriteRecord(writer, record);
+
+		++m_loggedCount;
+	}
+
+	/// @brief 上書きされた記録を除いてインデックスファイルを書き直す
+	/// @return 書き直せたか
+	bool compact() {
+		const FilePath temporaryPath = m_indexPath + U".tmp";
+
+		{
+			BinaryWriter writer{ temporaryPath };
+
+			if (not writer) return false;
+
+			WriteHeader(writer, m_legacyHash);
+
+			for (const auto& record : m_records) {
+				WriteRecord(writer, record);
+			}
+		}
+
+		FileSystem::Remove(m_indexPath);
+
+		if (not FileSystem::Rename(temporaryPath, m_indexPath)) return false;
+
+		m_loggedCount = m_records.size();
+		m_isDamaged = false;
+
+		return true;
+	}
+
+	Optional<uint32> findIndexById(StringView id) const {
+		auto it = std::ranges::lower_bound(m_byId, id, std::less{}, [&](uint32 i) { return StringView{ m_records[i].id }; });
+
+		if (it == m_byId.end() || m_records[*it].id != id) return none;
+
+		return *it;
+	}
+
+	/// @brief 記録を追加・更新する
+	void put(SongRecord record) {
+		append(record);
+
+		if (const auto index = findIndexById(record.id)) {
+			const bool retitled = (m_records[*index].title != record.title);
+
+			m_records[*index] = std::move(record);
+
+			if (retitled) rebuildIndices();
+
+			return;
+		}
+
+		const uint32 index = static_cast<uint32>(m_records.size());
+
+		m_records << std::move(record);
+
+		// 並びを保ったまま挿入する
+		const auto& added = m_records.back();
+
+		m_byId.insert(std::ranges::upper_bound(m_byId, StringView{ added.id }, std::less{}, [&](uint32 i) { return StringView{ m_records[i].id }; }), index);
+		m_byTitle.insert(std::ranges::upper_bound(m_byTitle, StringView{ added.title }, std::less{}, [&](uint32 i) { return StringView{ m_records[i].title }; }), index);
+	}
+
+	void erase(const String& id) {
+		SongRecord tombstone;
+		tombstone.id = id;
+		tombstone.removed = true;
+
+		append(tombstone);
+
+		m_records.remove_if([&](const SongRecord& r) { return r.id == id; });
+	}
+
+public:
+	SongLibrary() = default;
+
+	/// @brief インデックスを読み込み、曲フォルダと songinfo.json との差分だけを反映する
+	/// @param indexPath インデックスファイル
+	/// @param baseDir 曲フォルダのあるディレクトリ
+	/// @param legacyInfoPath songinfo.json (内容が前回から変わったときだけ取り込む)
+	SongLibrary(const FilePath& indexPath, const FilePath& baseDir, const FilePath& legacyInfoPath) : m_indexPath{ indexPath } {
+		load();
+
+		// 壊れた部分の後ろに追記しないよう、読めた記録だけで先に書き直す
+		if (m_isDamaged) {
+			compact();
+		}
+
+		// 新しく作ったときや読めなかったときはハッシュが空なので、すべて取り込む
+		const Blob legacySource{ Resource(legacyInfoPath) };
+		const String legacyHash = MD5::FromBinary(legacySource.data(), legacySource.size()).asString();
+
+		if (legacyHash != m_legacyHash && importLegacy(legacyInfoPath)) {
+			m_legacyHash = legacyHash;
+
+			// ヘッダのハッシュを書き換える
+			compact();
+		}
+
+		refresh(baseDir);
+
+		if (CompactionRatio * m_loggedCount > m_records.size()) {
+			compact();
+		}
+
+		rebuildIndices();
+	}
+
+	/// @brief JSON の曲情報を検証して SongRecord にする
+	/// @param json songinfo.json の要素、または info.json
+	/// @param id 曲のフォルダ名
+	static Optional<SongRecord> ParseRecord(const JSON& json, const String& id) {
+		if (not json.isObject()) return none;
+
+		for (const auto& key : { U"title", U"artist", U"bpm" }) {
+			if (not json[key].isString()) return none;
+		}
+
+		const JSON& difficulties = json[U"difficulties"];
+
+		if (not difficulties.isArray() || difficulties.size() != std::tuple_size_v<decltype(SongRecord::difficulties)>) return none;
+
+		SongRecord record;
+
+		record.id = id;
+		record.title = json[U"title"].getString();
+		record.artist = json[U"artist"].getString();
+		record.bpm = json[U"bpm"].getString();
+
+		for (size_t i = 0; i < record.difficulties.size(); ++i) {
+			if (not difficulties[i].isNumber()) return none;
+
+			record.difficulties[i] = difficulties[i].get<double>();
+		}
+
+		return record;
+	}
+
+	/// @brief songinfo.json の曲を取り込み、追加・変更された曲だけを書き足して、なくなった曲を消す
+	/// @remark info.json から登録した曲はそちらを優先して触らない
+	/// @return songinfo.json を読めたか
+	bool importLegacy(const FilePath& legacyInfoPath) {
+		const JSON json = JSON::Load(Resource(legacyInfoPath));
+
+		if (not json.isArray()) {
+			Logger << U"Invalid song list: {}"_fmt(legacyInfoPath);
+			return false;
+		}
+
+		HashSet<String> listed;
+
+		for (const JSON& data : json.arrayView()) {
+			if (not data[U"name"].isString()) continue;
+
+			const String id = data[U"name"].getString();
+
+			listed.emplace(id);
+
+			auto record = ParseRecord(data, id);
+
+			if (not record) {
+				Logger << U"Invalid song entry: {}"_fmt(data.formatMinimum());
+				continue;
+			}
+
+			if (const SongRecord* current = findById(id); current && (current->modified != DateTime{} || *current == *record)) continue;
+
+			put(std::move(*record));
+		}
+
+		// songinfo.json から登録した曲でなくなったもの
+		const Array<String> removed = m_records
+			.filter([&](const SongRecord& r) { return (r.modified == DateTime{}) && not listed.contains(r.id); })
+			.map([](const SongRecord& r) { return r.id; });
+
+		for (const String& id : removed) {
+			erase(id);
+		}
+
+		rebuildIndices();
+
+		return true;
+	}
+
+	/// @brief 曲フォルダの info.json のうち、追加・更新・削除されたものだけを反映する
+	/// @param baseDir 曲フォルダのあるディレクトリ
+	void refresh(const FilePath& baseDir) {
+		if (not FileSystem::IsDirectory(baseDir)) return;
+
+		HashSet<String> found;
+
+		for (const FilePath& songDir : FileSystem::DirectoryContents(baseDir, Recursive::No)) {
+			if (not FileSystem::IsDirectory(songDir)) continue;
+
+			const FilePath infoPath = FileSystem::PathAppend(songDir, U"info.json");
+			const Optional<DateTime> modified = FileSystem::WriteTime(infoPath);
+
+			if (not modified) continue;
+
+			// ディレクトリのパスは末尾が '/'
+			String id = songDir;
+
+			if (id.ends_with(U'/')) id.pop_back();
+
+			id = id.substr(id.lastIndexOf(U'/') + 1);
+
+			found.emplace(id);
+
+			if (const SongRecord* record = findById(id); record && record->modified == *modified) continue;
+
+			if (auto record = ParseRecord(JSON::Load(infoPath), id)) {
+				record->modified = *modified;
+
+				put(std::move(*record));
+			}
+			else {
+				Logger << U"Invalid song info: {}"_fmt(infoPath);
+			}
+		}
+
+		// info.json から登録した曲でフォルダがなくなったもの
+		const Array<String> removed = m_records
+			.filter([&](const SongRecord& r) { return (r.modified != DateTime{}) && not found.contains(r.id); })
+			.map([](const SongRecord& r) { return r.id; });
+
+		for (const String& id : removed) {
+			erase(id);
+		}
+
+		rebuildIndices();
+	}
+
+	/// @brief id で曲を探す O(log n)
+	const SongRecord* findById(StringView id) const {
+		if (const auto index = findIndexById(id)) return &m_records[*index];
+
+		return nullptr;
+	}
+
+	/// @brief タイトルで曲を探す O(log n)
+	const SongRecord* findByTitle(StringView title) const {
+		auto it = std::ranges::lower_bound(m_byTitle, title, std::less{}, [&](uint32 i) { return StringView{ m_records[i].title }; });
+
+		if (it == m_byTitle.end() || m_records[*it].title != title) return nullptr;
+
+		return &m_records[*it];
+	}
+
+	/// @brief 登録順の曲
+	const Array<SongRecord>& records() const noexcept {
+		return m_records;
+	}
+};
@@ -0,0 +1,167 @@
+﻿#pragma once
+#include <atomic>
+#include <mutex>
+
+#include "SongInfo.hpp"
+#include "SongLibrary.hpp"
+
+/// @brief ライブラリの各曲のファイルの確認を全コアで並列に行う
+/// @remark 結果はライブラリの順番どおりに takeReady() で受け取る
+class SongLibraryScanner {
+	struct Slot {
+		bool finished = false;
+		Optional<SongInfo> info;
+	};
+
+	Array<SongRecord> m_entries;
+
+	Array<Slot> m_slots;
+	std::mutex m_mutex;
+
+	std::atomic<size_t> m_next = 0;
+	std::atomic<size_t> m_finishedCount = 0;
+
+	// 次に takeReady() で返す位置
+	size_t m_taken = 0;
+
+	Array<AsyncTask<void>> m_workers;
+
+	/// @brief WAVのヘッダから曲の長さを得る
+	static Optional<double> ProbeWaveLength(const FilePath& path) {
+		BinaryReader reader{ path };
+
+		if (not reader) return none;
+
+		std::array<char, 4> riff{}, wave{};
+		uint32 riffSize = 0;
+
+		if (not (reader.read(riff) && reader.read(riffSize) && reader.read(wave))) return none;
+		if (riff != std::array<char, 4>{ 'R', 'I', 'F', 'F' } || wave != std::array<char, 4>{ 'W', 'A', 'V', 'E' }) return none;
+
+		uint32 byteRate = 0;
+
+		// fmt と data のチャンクだけ見る
+		while (true) {
+			std::array<char, 4> id{};
+			uint32 size = 0;
+
+			if (not (reader.read(id) && reader.read(size))) return none;
+
+			if (id == std::array<char, 4>{ 'f', 'm', 't', ' ' }) {
+				if (size < 16) return none;
+
+				uint16 format = 0, channels = 0;
+				uint32 sampleRate = 0;
+
+				if (not (reader.read(format) && reader.read(channels) && reader.read(sampleRate) && reader.read(byteRate))) return none;
+
+				reader.skip(static_cast<int64>(size) - 12);
+			}
+			else if (id == std::array<char, 4>{ 'd', 'a', 't', 'a' }) {
+				if (byteRate == 0) return none;
+
+				return static_cast<double>(size) / byteRate;
+			}
+			else {
+				reader.skip(static_cast<int64>(size) + (size & 1));
+			}
+		}
+	}
+
+	/// @brief 1曲分の検証とファイルの確認
+	static Optional<SongInfo> Scan(const SongRecord& record) {
+		if (record.id.isEmpty() || record.title.isEmpty()) return none;
+
+		SongInfo info{ record };
+
+		// ジャケットは読める画像かだけを確かめる
+		const Optional<ImageInfo> jacket = ImageDecoder::GetImageInfo(Resource(info.jacketPath));
+		const Optional<double> songLength = ProbeWaveLength(Resource(info.songPath));
+
+		if (not jacket || not songLength) return none;
+
+		info.songLengthSec = *songLength;
+
+		return info;
+	}
+
+	void work() {
+		for (size_t i = m_next++; i < m_entries.size(); i = m_next++) {
+			Optional<SongInfo> info;
+
+			try {
+				info = Scan(m_entries[i]);
+			}
+			catch (const Error&) {
+				info = none;
+			}
+			catch (const std::exception&) {
+				info = none;
+			}
+
+			{
+				std::lock_guard lock{ m_mutex };
+
+				m_slots[i].info = std::move(info);
+				m_slots[i].finished = true;
+			}
+
+			++m_finishedCount;
+		}
+	}
+
+public:
+	explicit SongLibraryScanner(const Array<SongRecord>& records) : m_entries{ records } {
+		m_slots.resize(m_entries.size());
+
+		const size_t workerCount = Clamp<size_t>(Threading::GetConcurrency(), 1, Max<size_t>(m_entries.size(), 1));
+
+		for ([[maybe_unused]] size_t i : step(workerCount)) {
+			m_workers << Async([this] { work(); });
+		}
+	}
+
+	SongLibraryScanner(const SongLibraryScanner&) = delete;
+	SongLibraryScanner& operator=(const SongLibraryScanner&) = delete;
+
+	~SongLibraryScanner() {
+		// 残りの仕事を打ち切ってワーカーの終了を待つ
+		m_next = m_entries.size();
+
+		for (auto& worker : m_workers) {
+			if (worker.isValid()) worker.wait();
+		}
+	}
+
+	/// @brief 先頭から連続して確認が終わった曲を取り出す
+	/// @return 新しく取り出せた曲(songinfo.json の順)
+	/// @remark 不正な曲は Logger に出力して飛ばす
+	Array<SongInfo> takeReady() {
+		Array<SongInfo> ready;
+
+		std::lock_guard lock{ m_mutex };
+
+		for (; m_taken < m_slots.size() && m_slots[m_taken].finished; ++m_taken) {
+			if (auto& info = m_slots[m_taken].info) {
+				ready << std::move(*info);
+			}
+			else {
+				Logger << U"Invalid song: {}"_fmt(m_entries[m_taken].id);
+			}
+		}
+
+		return ready;
+	}
+
+	/// @brief すべての曲を取り出し終えたか
+	bool isDone() const noexcept {
+		return m_slots.size() <= m_taken;
+	}
+
+	/// @brief 確認が終わった割合 (0.0 ~ 1.0)
+	double progress() const noexcept {
+		if (m_entries.isEmpty()) return 1.0;
+
+		return static_cast<double>(m_finishedCount) / m_entries.size();
+	}
+};
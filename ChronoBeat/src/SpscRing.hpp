@@ -0,0 +1,54 @@
+﻿#pragma once
+#include <atomic>
+#include <bit>
+
+/// @brief 書き込み1スレッド・読み出し1スレッド用のロックフリーなリングバッファ
+/// @tparam Type 要素(コピーできる型)
+/// @tparam Capacity 容量(2のべき乗)
+/// @remark push は書き込み側、pop は読み出し側のスレッドからだけ呼ぶこと
+template <class Type, size_t Capacity>
+class SpscRing {
+	static_assert(std::has_single_bit(Capacity), "capacity must be a power of two");
+
+	static constexpr size_t Mask = Capacity - 1;
+
+	std::array<Type, Capacity> m_buffer{};
+
+	// 書き込み側・読み出し側がそれぞれ更新する位置(同じキャッシュラインに載せない)
+	alignas(64) std::atomic<size_t> m_head = 0;
+	alignas(64) std::atomic<size_t> m_tail = 0;
+
+public:
+	/// @brief 末尾に追加する
+	/// @return いっぱいで追加できなければ false
+	bool push(const Type& value) noexcept {
+		const size_t head = m_head.load(std::memory_order_relaxed);
+
+		if (head - m_tail.load(std::memory_order_acquire) == Capacity) return false;
+
+		m_buffer[head & Mask] = value;
+
+		m_head.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	/// @brief 先頭を取り出す
+	/// @return 空なら false
+	bool pop(Type& value) noexcept {
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+		if (tail == m_head.load(std::memory_order_acquire)) return false;
+
+		value = m_buffer[tail & Mask];
+
+		m_tail.store(tail + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	/// @brief 読み出し側から見た要素数
+	size_t size() const noexcept {
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+	}
+};
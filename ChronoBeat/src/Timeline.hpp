@@ -0,0 +1,24 @@
+﻿#pragma once
+
+/// @brief 譜面・判定の時間軸
+/// @remark 時間はすべて int64 のマイクロ秒で持ち、秒(double)との変換は読み込み時と描画時だけ行う
+namespace Timeline {
+	inline constexpr int64 MicrosPerSec = 1'000'000;
+
+	/// @brief 秒をマイクロ秒にする(四捨五入)
+	constexpr int64 FromSec(double sec) noexcept {
+		const double us = sec * MicrosPerSec;
+
+		return static_cast<int64>((us < 0.0) ? (us - 0.5) : (us + 0.5));
+	}
+
+	/// @brief ミリ秒をマイクロ秒にする
+	constexpr int64 FromMillis(int64 ms) noexcept {
+		return ms * 1000;
+	}
+
+	/// @brief マイクロ秒を秒にする
+	constexpr double ToSec(int64 us) noexcept {
+		return static_cast<double>(us) / MicrosPerSec;
+	}
+}